@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. Empty files map to size() == 0
+// with a null data().
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &filename);
+    void close();
+    // Stops the read-ahead open() asks for, pages are read as they are first
+    // touched (for data sampled in any order). No-op on Windows.
+    void advise_random() const;
+
+    const std::uint8_t *data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool is_open() const { return open_; }
+private:
+    const std::uint8_t *data_ = nullptr;
+    std::size_t size_ = 0;
+    bool open_ = false;
+#if defined(_WIN32)
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif
+};
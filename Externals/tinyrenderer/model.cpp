@@ -1,58 +1,1019 @@
-#include <iostream>
-#include <string>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <sstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
 #include <vector>
+#include "mapped_file.h"
 #include "model.h"
 
-Model::Model(const char *filename) : verts_(), faces_(), initialized(false) {
-    initialized = false;
-
-    std::ifstream in;
-    in.open (filename, std::ifstream::in);
-    if (in.fail()) return;
-    std::string line;
-    while (!in.eof()) {
-        std::getline(in, line);
-        std::istringstream iss(line.c_str());
-        char trash;
-        if (!line.compare(0, 2, "v ")) {
-            iss >> trash;
-            Vec3f v;
-            for (int i=0;i<3;i++) iss >> v.raw[i];
-            verts_.push_back(v);
-        } else if (!line.compare(0, 2, "f ")) {
-            std::vector<int> f;
-            int itrash, idx;
-            iss >> trash;
-            while (iss >> idx >> trash >> itrash >> trash >> itrash) {
-                idx--; // in wavefront obj all indices start at 1, not zero
-                f.push_back(idx);
-            }
-            faces_.push_back(f);
+static constexpr std::uint32_t ms_no_index = UINT32_MAX;
+
+struct ObjCorner {
+    std::uint32_t v, vt, vn;
+    bool operator==(const ObjCorner &) const = default;
+};
+
+// The loader parses the mapped file in place: no iostreams, no locale and no
+// copy of the lines. Only the records the model keeps are decoded, anything
+// else (g, usemtl, comments) is skipped up to the end of its line.
+
+static bool is_blank(char c) {
+    return ' ' == c || '\t' == c || '\r' == c;
+}
+
+static const char *skip_blanks(const char *p, const char *end) {
+    while (p < end && is_blank(*p)) p++;
+    return p;
+}
+
+// end of the line or a trailing comment ahead, blanks aside
+static bool at_line_end(const char *p, const char *end) {
+    p = skip_blanks(p, end);
+    return p == end || '#' == *p;
+}
+
+static const char *next_line(const char *p, const char *end) {
+    const void *nl = std::memchr(p, '\n', end - p);
+    return nl ? static_cast<const char *>(nl) + 1 : end;
+}
+
+// record tag at p, "v", "vt", "f", ..., followed by a blank
+static bool is_record(const char *p, const char *end, const char *tag) {
+    const std::size_t length = std::strlen(tag);
+    return static_cast<std::size_t>(end - p) > length && 0 == std::memcmp(p, tag, length) && is_blank(p[length]);
+}
+
+// Decimal float as strtof would round it. Up to 19 significant digits with a
+// decimal exponent of at most 22 are exact in doubles, the double is then
+// rounded once more to float; the few cases where that second rounding can
+// go wrong and everything longer go through std::from_chars.
+static const char *parse_float(const char *p, const char *end, float &value) {
+    static constexpr double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char *start = p;
+    const bool negative = p < end && '-' == *p;
+    if (p < end && ('-' == *p || '+' == *p)) p++;
+
+    std::uint64_t mantissa = 0;
+    int digits = 0, exponent = 0; // significant digits, leading zeros excluded
+    const char *first_digit = p;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        if (digits || '0' != *p) digits++;
+        mantissa = mantissa * 10 + (*p - '0');
+        if (digits > 19) break;
+    }
+    bool has_digits = p != first_digit;
+    if (p < end && '.' == *p) {
+        const char *first_fraction = ++p;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (digits || '0' != *p) digits++;
+            mantissa = mantissa * 10 + (*p - '0');
+            exponent--;
+            if (digits > 19) break;
+        }
+        has_digits |= p != first_fraction;
+    }
+    if (has_digits && p < end && ('e' == *p || 'E' == *p)) {
+        const char *q = p + 1;
+        const bool exp_negative = q < end && '-' == *q;
+        if (q < end && ('-' == *q || '+' == *q)) q++;
+        if (q < end && *q >= '0' && *q <= '9') {
+            int e = 0;
+            for (; q < end && *q >= '0' && *q <= '9'; q++)
+                if (e < 10000) e = e * 10 + (*q - '0');
+            exponent += exp_negative ? -e : e;
+            p = q;
         }
     }
-    std::cerr << "# v# " << verts_.size() << " f# "  << faces_.size() << std::endl;
+
+    if (has_digits && digits <= 19 && exponent >= -22 && exponent <= 22 && mantissa < (1ull << 53)) {
+        double d = static_cast<double>(mantissa);
+        d = exponent < 0 ? d / pow10[-exponent] : d * pow10[exponent];
+        std::uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        // a double exactly halfway between two floats would round twice
+        if ((bits & 0x1fffffffu) != 0x10000000u) {
+            value = static_cast<float>(negative ? -d : d);
+            return p;
+        }
+    }
+
+    // from_chars takes no '+' sign
+    if (start < end && '+' == *start) start++;
+    const std::from_chars_result result = std::from_chars(start, end, value);
+    return std::errc() == result.ec ? result.ptr : nullptr;
+}
+
+// Indices past 32 bits can't address a record, such lines are rejected
+// before the value overflows (long is 32 bit on Windows)
+static constexpr std::int64_t ms_max_int = 0xffffffffll;
+
+static const char *parse_int(const char *p, const char *end, std::int64_t &value) {
+    const bool negative = p < end && '-' == *p;
+    if (p < end && ('-' == *p || '+' == *p)) p++;
+    if (p == end || *p < '0' || *p > '9') return nullptr;
+    std::int64_t v = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        v = v * 10 + (*p - '0');
+        if (v > ms_max_int) return nullptr;
+    }
+    value = negative ? -v : v;
+    return p;
+}
+
+// Attribute arrays in file order, faces index them
+struct ObjRecords {
+    std::vector<Vec3f> positions;
+    std::vector<Vec2f> texcoords;
+    std::vector<Vec3f> normals;
+    // corners of the fan triangles, ms_no_index where a corner has no vt or vn
+    std::vector<ObjCorner> corners;
+};
+
+// Records of each kind, the counting pass fills them per chunk and the
+// prefix sums turn them into the counts before every chunk
+struct ObjCounts {
+    std::size_t positions = 0;
+    std::size_t texcoords = 0;
+    std::size_t normals = 0;
+    std::size_t faces = 0;
+    std::size_t lines = 0;
+};
+
+// Newline aligned piece of the file, one job of each pass
+struct ObjChunk {
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    ObjCounts counts; // in the chunk
+    ObjCounts before; // in the chunks before it
+    std::vector<ObjCorner> corners;
+    std::size_t corners_before = 0;
+    std::size_t error_line = 0; // 1-based within the chunk, 0 when it parsed
+};
+
+// Files below two chunks are parsed on the calling thread
+static constexpr std::size_t ms_chunk_bytes = 1 << 20;
+
+// 1-based or negative (relative to the last record) index into count records
+static const char *parse_index(const char *p, const char *end, std::size_t count, std::uint32_t &index) {
+    std::int64_t idx;
+    p = parse_int(p, end, idx);
+    if (!p) return nullptr;
+    idx = idx < 0 ? static_cast<std::int64_t>(count) + idx : idx - 1;
+    if (idx < 0 || idx >= static_cast<std::int64_t>(count)) return nullptr;
+    index = static_cast<std::uint32_t>(idx);
+    return p;
+}
+
+// "f" records: v, v/vt, v//vn or v/vt/vn per corner, indexing the records
+// read so far. Polygons are split into triangle fans.
+static bool parse_face(const char *p, const char *end, const ObjCounts &counts, std::vector<ObjCorner> &polygon,
+                       std::vector<ObjCorner> &corners) {
+    polygon.clear();
+    while (!at_line_end(p, end)) {
+        p = skip_blanks(p, end);
+        ObjCorner corner = { 0, ms_no_index, ms_no_index };
+        p = parse_index(p, end, counts.positions, corner.v);
+        if (p && p < end && '/' == *p) {
+            p++;
+            if (p < end && '/' != *p)
+                p = parse_index(p, end, counts.texcoords, corner.vt);
+            if (p && p < end && '/' == *p)
+                p = parse_index(p + 1, end, counts.normals, corner.vn);
+        }
+        if (!p || (p < end && !is_blank(*p) && '#' != *p)) return false;
+        polygon.push_back(corner);
+    }
+    for (std::size_t i=2; i<polygon.size(); i++) {
+        corners.push_back(polygon[0]);
+        corners.push_back(polygon[i-1]);
+        corners.push_back(polygon[i]);
+    }
+    return true;
+}
+
+static const char *parse_floats(const char *p, const char *end, float *values, int count) {
+    for (int i=0; i<count && p; i++)
+        p = parse_float(skip_blanks(p, end), end, values[i]);
+    return p;
+}
+
+// counting pass, a memchr per line is far cheaper than parsing it
+static void count_chunk(ObjChunk &chunk) {
+    ObjCounts &counts = chunk.counts;
+    for (const char *line = chunk.begin; line < chunk.end; line = next_line(line, chunk.end)) {
+        const char *p = skip_blanks(line, chunk.end);
+        counts.positions += is_record(p, chunk.end, "v");
+        counts.texcoords += is_record(p, chunk.end, "vt");
+        counts.normals += is_record(p, chunk.end, "vn");
+        counts.faces += is_record(p, chunk.end, "f");
+        counts.lines++;
+    }
+}
+
+// The attributes go straight to their final place in records, faces see the
+// records before the chunk as if the file was parsed front to back
+static void parse_chunk(ObjChunk &chunk, ObjRecords &records) {
+    ObjCounts read = chunk.before;
+    std::vector<ObjCorner> polygon;
+    chunk.corners.reserve(chunk.counts.faces * 3);
+    std::size_t line_number = 0;
+    for (const char *line = chunk.begin; line < chunk.end; ) {
+        const char *next = next_line(line, chunk.end);
+        const char *line_end = next - (next > line && '\n' == next[-1]);
+        line_number++;
+        const char *p = skip_blanks(line, line_end);
+        bool ok = true;
+        if (is_record(p, line_end, "v")) {
+            ok = parse_floats(p + 2, line_end, records.positions[read.positions++].raw, 3);
+        } else if (is_record(p, line_end, "vt")) {
+            // v is optional, w is ignored
+            Vec2f &uv = records.texcoords[read.texcoords++];
+            p = parse_floats(p + 3, line_end, &uv.u, 1);
+            if (p && !at_line_end(p, line_end))
+                p = parse_floats(p, line_end, &uv.v, 1);
+            ok = p;
+        } else if (is_record(p, line_end, "vn")) {
+            ok = parse_floats(p + 3, line_end, records.normals[read.normals++].raw, 3);
+        } else if (is_record(p, line_end, "f")) {
+            ok = parse_face(p + 2, line_end, read, polygon, chunk.corners);
+        }
+        if (!ok) {
+            chunk.error_line = line_number;
+            return;
+        }
+        line = next;
+    }
+}
+
+// Large files are cut into newline aligned chunks. parallel_for counts the
+// records of every chunk, prefix sums place each chunk's records in the
+// shared arrays and a second pass parses all chunks at once. Face corners
+// are gathered per chunk and concatenated in file order at the end.
+static bool parse_records(const char *begin, const char *end, const char *filename, ParallelFor parallel_for, ObjRecords &records) {
+    std::vector<ObjChunk> chunks;
+    for (const char *chunk = begin; chunk < end; ) {
+        const char *chunk_end = end - chunk > static_cast<std::ptrdiff_t>(ms_chunk_bytes)
+            ? next_line(chunk + ms_chunk_bytes - 1, end) : end;
+        chunks.emplace_back();
+        chunks.back().begin = chunk;
+        chunks.back().end = chunk_end;
+        chunk = chunk_end;
+    }
+    const std::uint32_t nchunks = static_cast<std::uint32_t>(chunks.size());
+    auto for_each_chunk = [&](auto &&fn) {
+        parallel_for(nchunks, 1, [&](std::uint32_t first, std::uint32_t last) {
+            for (std::uint32_t c=first; c<last; c++) fn(chunks[c]);
+        });
+    };
+
+    for_each_chunk([](ObjChunk &chunk) { count_chunk(chunk); });
+    ObjCounts total;
+    for (ObjChunk &chunk : chunks) {
+        chunk.before = total;
+        total.positions += chunk.counts.positions;
+        total.texcoords += chunk.counts.texcoords;
+        total.normals += chunk.counts.normals;
+        total.faces += chunk.counts.faces;
+        total.lines += chunk.counts.lines;
+    }
+    records.positions.resize(total.positions);
+    records.texcoords.resize(total.texcoords);
+    records.normals.resize(total.normals);
+
+    for_each_chunk([&](ObjChunk &chunk) { parse_chunk(chunk, records); });
+    std::size_t ncorners = 0;
+    for (ObjChunk &chunk : chunks) {
+        if (chunk.error_line) {
+            std::cerr << filename << ":" << chunk.before.lines + chunk.error_line << ": malformed record" << std::endl;
+            return false;
+        }
+        chunk.corners_before = ncorners;
+        ncorners += chunk.corners.size();
+    }
+
+    if (1 == nchunks) {
+        records.corners = std::move(chunks[0].corners);
+        return true;
+    }
+    records.corners.resize(ncorners);
+    for_each_chunk([&](ObjChunk &chunk) {
+        std::copy(chunk.corners.begin(), chunk.corners.end(), records.corners.begin() + chunk.corners_before);
+        chunk.corners = {};
+    });
+    return true;
+}
+
+// Open addressing table from (v, vt, vn) to the vertex made for it, sized to
+// at most half full
+class CornerTable {
+public:
+    explicit CornerTable(std::size_t corners) {
+        std::size_t size = 16;
+        while (size < corners * 2) size *= 2;
+        slots_.assign(size, ms_no_index);
+        mask_ = size - 1;
+    }
+
+    // vertex of corner, or ms_no_index with slot set for insert()
+    std::uint32_t find(const ObjCorner &corner, const std::vector<ObjCorner> &vertices, std::size_t &slot) const {
+        slot = (corner.v * 0x9e3779b1u ^ corner.vt * 0x85ebca77u ^ corner.vn * 0xc2b2ae3du) & mask_;
+        for (;; slot = (slot + 1) & mask_) {
+            const std::uint32_t vertex = slots_[slot];
+            if (ms_no_index == vertex || vertices[vertex] == corner)
+                return vertex;
+        }
+    }
+    void insert(std::size_t slot, std::uint32_t vertex) { slots_[slot] = vertex; }
+private:
+    std::vector<std::uint32_t> slots_;
+    std::size_t mask_;
+};
+
+//---------------------------------------------------------------------------//
+// Mesh cache: the model as it sits in memory, so a later load maps the file
+// and points the spans into it. Little endian, every stream 64 byte aligned.
+// Loads check the header against its checksum and every index against the
+// vertex count, an index past the vertices would send the pipeline outside
+// its arrays. The streams' checksums are only compared when asked for:
+// hashing them reads every page of the file, which costs more than the
+// mapping saves.
+//---------------------------------------------------------------------------//
+static constexpr char ms_cache_magic[4] = { 'T', 'R', 'M', 'C' };
+static constexpr std::uint32_t ms_cache_version = 2;
+static constexpr std::uint64_t ms_cache_align = 64;
+
+static constexpr std::uint32_t ms_cache_uvs = 1;
+static constexpr std::uint32_t ms_cache_normals = 2;
+static constexpr std::uint32_t ms_cache_indices16 = 4;
+
+struct MeshCacheHeader {
+    char magic[4];
+    std::uint32_t version;
+    // the obj the cache was made from, a different size or time rebuilds it
+    std::uint64_t source_size;
+    std::int64_t source_time;
+    std::uint32_t nverts;
+    std::uint32_t nindices;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+    float bounds_min[3];
+    float bounds_max[3];
+    // byte offsets from the start of the file, 0 for missing streams
+    std::uint64_t verts_offset;
+    std::uint64_t uvs_offset;
+    std::uint64_t normals_offset;
+    std::uint64_t indices_offset;
+    std::uint64_t file_size;
+    // of the verts, uvs, normals and indices streams, 0 for missing ones
+    std::uint64_t stream_checksums[4];
+    // of the header bytes before it
+    std::uint64_t header_checksum;
+};
+static_assert(sizeof(MeshCacheHeader) % 8 == 0, "the payload starts 8 byte aligned");
+
+static std::uint64_t align_up(std::uint64_t offset) {
+    return (offset + ms_cache_align - 1) / ms_cache_align * ms_cache_align;
+}
+
+// FNV-1a over 64 bit words, a partial last word is padded with zeros
+static std::uint64_t checksum(const std::uint8_t *data, std::size_t size) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (std::size_t i=0; i<size; i+=8) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, data + i, std::min<std::size_t>(8, size - i));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static std::uint64_t header_checksum(const MeshCacheHeader &header) {
+    return checksum(reinterpret_cast<const std::uint8_t *>(&header), offsetof(MeshCacheHeader, header_checksum));
+}
+
+// offset and bytes of stream i (verts, uvs, normals, indices), 0 bytes for
+// missing ones
+static void cache_stream(const MeshCacheHeader &header, int i, std::uint64_t &offset, std::uint64_t &bytes) {
+    const std::uint64_t index_size = (header.flags & ms_cache_indices16) ? 2 : 4;
+    const std::uint64_t offsets[4] = { header.verts_offset, header.uvs_offset, header.normals_offset, header.indices_offset };
+    const std::uint64_t sizes[4] = { header.nverts * sizeof(Vec3f),
+                                     (header.flags & ms_cache_uvs) ? header.nverts * sizeof(Vec2f) : 0,
+                                     (header.flags & ms_cache_normals) ? header.nverts * sizeof(Vec3f) : 0,
+                                     header.nindices * index_size };
+    offset = offsets[i];
+    bytes = sizes[i];
+}
+
+static std::string cache_path(const char *filename) {
+    return std::string(filename) + ".mesh";
+}
+
+static bool source_stamp(const char *filename, std::uint64_t &size, std::int64_t &time) {
+    std::error_code error;
+    const std::filesystem::path path(filename);
+    size = std::filesystem::file_size(path, error);
+    if (error) return false;
+    time = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    return !error;
+}
+
+// Header of a mapped cache file with every stream inside the file, no
+// check of the streams and none against the source obj
+static bool read_cache_header(const MappedFile &file, MeshCacheHeader &header) {
+    if (file.size() < sizeof(MeshCacheHeader)) return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (0 != std::memcmp(header.magic, ms_cache_magic, sizeof(header.magic)) || ms_cache_version != header.version ||
+        header_checksum(header) != header.header_checksum || file.size() != header.file_size)
+        return false;
+
+    // a stream of count elements at offset, inside the file
+    auto stream = [&](std::uint64_t offset, std::uint64_t count, std::uint64_t element) {
+        return 0 != offset && offset % ms_cache_align == 0 && offset <= header.file_size &&
+               count <= (header.file_size - offset) / element;
+    };
+    return stream(header.verts_offset, header.nverts, sizeof(Vec3f)) &&
+           (!(header.flags & ms_cache_uvs) || stream(header.uvs_offset, header.nverts, sizeof(Vec2f))) &&
+           (!(header.flags & ms_cache_normals) || stream(header.normals_offset, header.nverts, sizeof(Vec3f))) &&
+           stream(header.indices_offset, header.nindices, (header.flags & ms_cache_indices16) ? 2 : 4);
+}
+
+// largest of count indices below nverts, true for none
+template <typename Index>
+static bool indices_in_range(const std::uint8_t *data, std::uint64_t count, std::uint32_t nverts) {
+    Index largest = 0;
+    for (std::uint64_t i=0; i<count; i++) {
+        Index index;
+        std::memcpy(&index, data + i * sizeof(Index), sizeof(Index));
+        largest = std::max(largest, index);
+    }
+    return 0 == count || largest < nverts;
+}
+
+bool Model::load_cache(const std::string &path, std::uint64_t source_size, std::int64_t source_time, bool verify) {
+    auto file = std::make_unique<MappedFile>();
+    MeshCacheHeader header;
+    if (!file->open(path) || !read_cache_header(*file, header) ||
+        source_size != header.source_size || source_time != header.source_time)
+        return false;
+    const std::uint8_t *data = file->data();
+    const bool indices16 = header.flags & ms_cache_indices16;
+    for (int i=0; verify && i<4; i++) {
+        std::uint64_t offset, bytes;
+        cache_stream(header, i, offset, bytes);
+        if (bytes && checksum(data + offset, bytes) != header.stream_checksums[i]) return false;
+    }
+    const std::uint8_t *indices = data + header.indices_offset;
+    if (!(indices16 ? indices_in_range<std::uint16_t>(indices, header.nindices, header.nverts)
+                    : indices_in_range<std::uint32_t>(indices, header.nindices, header.nverts)))
+        return false;
+
+    verts_ = { reinterpret_cast<const Vec3f *>(data + header.verts_offset), header.nverts };
+    if (header.flags & ms_cache_uvs)
+        uvs_ = { reinterpret_cast<const Vec2f *>(data + header.uvs_offset), header.nverts };
+    if (header.flags & ms_cache_normals)
+        normals_ = { reinterpret_cast<const Vec3f *>(data + header.normals_offset), header.nverts };
+    if (indices16)
+        indices16_ = { reinterpret_cast<const std::uint16_t *>(data + header.indices_offset), header.nindices };
+    else
+        indices32_ = { reinterpret_cast<const std::uint32_t *>(data + header.indices_offset), header.nindices };
+    bounds_min_ = Vec3f(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+    bounds_max_ = Vec3f(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+    cache_ = std::move(file);
+    return true;
+}
+
+// Written to a temporary name and renamed, a concurrent loader sees either
+// no cache or a complete one. Failing to write it only costs the next load.
+void Model::write_cache(const std::string &path, std::uint64_t source_size, std::int64_t source_time) const {
+    MeshCacheHeader header = {};
+    std::memcpy(header.magic, ms_cache_magic, sizeof(header.magic));
+    header.version = ms_cache_version;
+    header.source_size = source_size;
+    header.source_time = source_time;
+    header.nverts = static_cast<std::uint32_t>(verts_.size());
+    header.nindices = static_cast<std::uint32_t>(indices16_.size() + indices32_.size());
+    header.flags = (has_uvs() ? ms_cache_uvs : 0) | (has_normals() ? ms_cache_normals : 0) |
+                   (has_indices16() ? ms_cache_indices16 : 0);
+    for (int i=0; i<3; i++) {
+        header.bounds_min[i] = bounds_min_.raw[i];
+        header.bounds_max[i] = bounds_max_.raw[i];
+    }
+
+    std::vector<std::uint8_t> file(sizeof(header));
+    auto append = [&](const void *data, std::size_t bytes) -> std::uint64_t {
+        const std::uint64_t offset = align_up(file.size());
+        file.resize(offset + bytes);
+        if (bytes) std::memcpy(file.data() + offset, data, bytes);
+        return offset;
+    };
+    header.verts_offset = append(verts_.data(), verts_.size_bytes());
+    if (has_uvs()) header.uvs_offset = append(uvs_.data(), uvs_.size_bytes());
+    if (has_normals()) header.normals_offset = append(normals_.data(), normals_.size_bytes());
+    header.indices_offset = has_indices16() ? append(indices16_.data(), indices16_.size_bytes())
+                                            : append(indices32_.data(), indices32_.size_bytes());
+    file.resize((file.size() + 7) / 8 * 8);
+    header.file_size = file.size();
+    for (int i=0; i<4; i++) {
+        std::uint64_t offset, bytes;
+        cache_stream(header, i, offset, bytes);
+        header.stream_checksums[i] = bytes ? checksum(file.data() + offset, bytes) : 0;
+    }
+    header.header_checksum = header_checksum(header);
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.write(reinterpret_cast<const char *>(file.data()), file.size())) {
+            out.close();
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) std::remove(temporary.c_str());
+}
+
+//---------------------------------------------------------------------------//
+// Model
+//---------------------------------------------------------------------------//
+Model::Model(const char *filename, bool use_cache, bool verify_cache, ParallelFor parallel_for) {
+    std::uint64_t source_size = 0;
+    std::int64_t source_time = 0;
+    use_cache = use_cache && source_stamp(filename, source_size, source_time);
+    if (use_cache && load_cache(cache_path(filename), source_size, source_time, verify_cache)) {
+        from_cache = true;
+    } else {
+        if (!load_obj(filename, parallel_for)) return;
+        if (use_cache) write_cache(cache_path(filename), source_size, source_time);
+    }
+    // a single write, models may load on several threads at once
+    std::cerr << "# v# " + std::to_string(verts_.size()) + " f# " + std::to_string(nfaces()) +
+                 (from_cache ? " (cached)\n" : "\n") << std::flush;
 
     initialized = true;
 }
 
+bool Model::load_obj(const char *filename, ParallelFor parallel_for) {
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    const char *begin = reinterpret_cast<const char *>(file.data());
+    ObjRecords records;
+    if (!parse_records(begin, begin + file.size(), filename, parallel_for, records)) return false;
+    file.close();
+
+    bool any_uv = false, any_normal = false;
+    for (const ObjCorner &corner : records.corners) {
+        any_uv |= ms_no_index != corner.vt;
+        any_normal |= ms_no_index != corner.vn;
+    }
+
+    std::vector<std::uint32_t> &indices = index32_storage_;
+    if (!any_uv && !any_normal) {
+        // positions only, the obj indices are the vertex indices:
+        vert_storage_ = std::move(records.positions);
+        indices.reserve(records.corners.size());
+        for (const ObjCorner &corner : records.corners)
+            indices.push_back(corner.v);
+    } else {
+        // one vertex per distinct (v, vt, vn), in order of first use:
+        std::vector<ObjCorner> vertices;
+        CornerTable table(records.corners.size());
+        indices.reserve(records.corners.size());
+        for (const ObjCorner &corner : records.corners) {
+            std::size_t slot;
+            std::uint32_t vertex = table.find(corner, vertices, slot);
+            if (ms_no_index == vertex) {
+                vertex = static_cast<std::uint32_t>(vertices.size());
+                table.insert(slot, vertex);
+                vertices.push_back(corner);
+            }
+            indices.push_back(vertex);
+        }
+
+        vert_storage_.resize(vertices.size());
+        if (any_uv) uv_storage_.resize(vertices.size());
+        if (any_normal) normal_storage_.resize(vertices.size());
+        for (std::size_t i=0; i<vertices.size(); i++) {
+            vert_storage_[i] = records.positions[vertices[i].v];
+            if (any_uv && ms_no_index != vertices[i].vt) uv_storage_[i] = records.texcoords[vertices[i].vt];
+            if (any_normal && ms_no_index != vertices[i].vn) normal_storage_[i] = records.normals[vertices[i].vn];
+        }
+    }
+
+    if (vert_storage_.size() <= 0x10000) {
+        index16_storage_.assign(indices.begin(), indices.end());
+        indices = {};
+    }
+
+    bounds_min_ = bounds_max_ = vert_storage_.empty() ? Vec3f() : vert_storage_[0];
+    for (const Vec3f &v : vert_storage_) {
+        for (int i=0; i<3; i++) {
+            bounds_min_.raw[i] = std::min(bounds_min_.raw[i], v.raw[i]);
+            bounds_max_.raw[i] = std::max(bounds_max_.raw[i], v.raw[i]);
+        }
+    }
+
+    verts_ = vert_storage_;
+    uvs_ = uv_storage_;
+    normals_ = normal_storage_;
+    indices16_ = index16_storage_;
+    indices32_ = index32_storage_;
+    return true;
+}
+
 Model::~Model() {
 }
 
-int Model::nverts() {
+int Model::nverts() const {
     return (int)verts_.size();
 }
 
-int Model::nfaces() {
-    return (int)faces_.size();
+int Model::nfaces() const {
+    return (int)((indices16_.size() + indices32_.size()) / 3);
 }
 
-std::vector<int> Model::face(int idx) {
-    return faces_[idx];
+int Model::ntriangles() const {
+    return nfaces();
 }
 
-Vec3f Model::vert(int i) {
+Vec3f Model::vert(int i) const {
     return verts_[i];
 }
 
+Vec2f Model::uv(int i) const {
+    return has_uvs() ? uvs_[i] : Vec2f();
+}
+
+Vec3f Model::normal(int i) const {
+    return has_normals() ? normals_[i] : Vec3f();
+}
+
+Vec3f Model::bounds_min() const {
+    return bounds_min_;
+}
+
+Vec3f Model::bounds_max() const {
+    return bounds_max_;
+}
+
+std::array<std::uint32_t, 3> Model::triangle(int idx) const {
+    if (has_indices16())
+        return { indices16_[3*idx], indices16_[3*idx+1], indices16_[3*idx+2] };
+    return { indices32_[3*idx], indices32_[3*idx+1], indices32_[3*idx+2] };
+}
+
+std::span<const Vec3f> Model::verts() const {
+    return verts_;
+}
+
+bool Model::has_uvs() const {
+    return !uvs_.empty();
+}
+
+bool Model::has_normals() const {
+    return !normals_.empty();
+}
+
+std::span<const Vec2f> Model::uvs() const {
+    return uvs_;
+}
+
+std::span<const Vec3f> Model::normals() const {
+    return normals_;
+}
+
+bool Model::has_indices16() const {
+    return !indices16_.empty();
+}
+
+std::span<const std::uint16_t> Model::indices16() const {
+    return indices16_;
+}
+
+std::span<const std::uint32_t> Model::indices32() const {
+    return indices32_;
+}
+
+//---------------------------------------------------------------------------//
+// Streaming
+//---------------------------------------------------------------------------//
+// Reads [offset, offset + length) of a file front to back on its own thread
+// into two buffers, one is filled while the consumer works on the other
+class BlockReader {
+public:
+    BlockReader(const std::string &path, std::uint64_t offset, std::uint64_t length, std::size_t block_bytes)
+        : in_(path, std::ios::binary), remaining_(length) {
+        if (!in_.seekg(static_cast<std::streamoff>(offset))) return;
+        for (Block &block : blocks_)
+            block.data.resize(block_bytes);
+        thread_ = std::thread(&BlockReader::run, this);
+    }
+    ~BlockReader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    bool is_open() const { return thread_.joinable(); }
+    bool failed() const { return error_; }
+
+    // Next block in file order, waits for it. False at the end or on a read
+    // error, and again on every later call.
+    bool next(const char *&data, std::size_t &size) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Block &block = blocks_[consumer_];
+        cv_.wait(lock, [&] { return block.ready; });
+        data = block.data.data();
+        size = block.size;
+        return 0 != size;
+    }
+    // hands the block from next() back to the reader
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            blocks_[consumer_].ready = false;
+            consumer_ ^= 1;
+        }
+        cv_.notify_all();
+    }
+private:
+    struct Block {
+        std::vector<char> data;
+        std::size_t size = 0;
+        bool ready = false; // filled, owned by the consumer
+    };
+
+    // an empty block marks the end
+    void run() {
+        for (int i=0;; i^=1) {
+            Block &block = blocks_[i];
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&] { return stop_ || !block.ready; });
+                if (stop_) return;
+            }
+            const std::size_t bytes = static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, block.data.size()));
+            const bool ok = 0 == bytes || in_.read(block.data.data(), static_cast<std::streamsize>(bytes));
+            remaining_ -= bytes;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                block.size = ok ? bytes : 0;
+                block.ready = true;
+                error_ = !ok;
+            }
+            cv_.notify_all();
+            if (0 == block.size) return;
+        }
+    }
+
+    std::ifstream in_;
+    std::uint64_t remaining_;
+    Block blocks_[2];
+    int consumer_ = 0;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    bool error_ = false;
+    std::thread thread_;
+};
+
+ModelStream::ModelStream(const char *filename, std::size_t block_bytes, std::size_t batch_triangles, bool use_cache)
+    : spill_limit_(std::max<std::size_t>(block_bytes / sizeof(Vec3f), 1024)),
+      batch_triangles_(std::max<std::size_t>(1, batch_triangles)), filename_(filename) {
+    std::uint64_t source_size = 0;
+    std::int64_t source_time = 0;
+    if (!source_stamp(filename, source_size, source_time)) return;
+
+    // a mesh cache given directly or the obj's own, else the obj text:
+    if (!open_cache(filename, 0, 0) && !(use_cache && open_cache(cache_path(filename), source_size, source_time)))
+        reader_ = std::make_unique<BlockReader>(filename, 0, source_size, std::max<std::size_t>(block_bytes, 4096));
+    initialized = reader_->is_open();
+}
+
+ModelStream::~ModelStream() {
+    spill_map_.reset();
+    if (spill_) std::fclose(spill_);
+    if (!spill_path_.empty()) std::remove(spill_path_.c_str());
+}
+
+// source_size 0 takes the cache as it is
+bool ModelStream::open_cache(const std::string &path, std::uint64_t source_size, std::int64_t source_time) {
+    auto file = std::make_unique<MappedFile>();
+    MeshCacheHeader header;
+    if (!file->open(path) || !read_cache_header(*file, header) ||
+        (source_size && (source_size != header.source_size || source_time != header.source_time)))
+        return false;
+
+    // only the vertex stream is used through the mapping, indices are read
+    // a batch per block
+    verts_ = { reinterpret_cast<const Vec3f *>(file->data() + header.verts_offset), header.nverts };
+    indices16_ = header.flags & ms_cache_indices16;
+    const std::size_t index_bytes = indices16_ ? 2 : 4;
+    reader_ = std::make_unique<BlockReader>(path, header.indices_offset, header.nindices * index_bytes,
+                                            batch_triangles_ * 3 * index_bytes);
+    cache_ = std::move(file);
+    return true;
+}
+
+// Creates a file of its own in the temp directory, "x" fails on a name
+// that is taken
+static std::FILE *create_spill_file(std::string &path) {
+    static std::atomic<std::uint32_t> s_counter = 0;
+    std::error_code error;
+    const std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+    if (error) return nullptr;
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    for (int attempt=0; attempt<16; attempt++) {
+        const std::string name = "modelstream-" + std::to_string(stamp) + "-" + std::to_string(s_counter++) + ".tmp";
+        path = (directory / name).string();
+        if (std::FILE *file = std::fopen(path.c_str(), "wbx")) return file;
+    }
+    path.clear();
+    return nullptr;
+}
+
+// Appends the positions kept in memory to the temporary file. The mapping
+// is dropped first, Windows doesn't let a mapped file grow.
+bool ModelStream::spill_positions() {
+    spill_map_.reset();
+    verts_ = {};
+    if (!spill_) spill_ = spill_path_.empty() ? create_spill_file(spill_path_) : std::fopen(spill_path_.c_str(), "ab");
+    if (!spill_ || vert_storage_.size() != std::fwrite(vert_storage_.data(), sizeof(Vec3f), vert_storage_.size(), spill_)) {
+        std::cerr << filename_ << ": can't write positions to a temporary file" << std::endl;
+        return false;
+    }
+    vert_storage_.clear();
+    return true;
+}
+
+// Points verts_ at every position read so far
+bool ModelStream::map_positions() {
+    if (spill_path_.empty()) {
+        verts_ = vert_storage_;
+        return true;
+    }
+    if (!vert_storage_.empty() && !spill_positions()) return false;
+    if (spill_) {
+        const bool closed = 0 == std::fclose(spill_);
+        spill_ = nullptr;
+        if (!closed) {
+            std::cerr << filename_ << ": can't write positions to a temporary file" << std::endl;
+            return false;
+        }
+    }
+    if (!spill_map_) {
+        spill_map_ = std::make_unique<MappedFile>();
+        if (!spill_map_->open(spill_path_) || spill_map_->size() < nverts_ * sizeof(Vec3f)) {
+            std::cerr << filename_ << ": can't map the temporary positions file" << std::endl;
+            return false;
+        }
+        spill_map_->advise_random();
+    }
+    verts_ = { reinterpret_cast<const Vec3f *>(spill_map_->data()), nverts_ };
+    return true;
+}
+
+bool ModelStream::parse_line(const char *p, const char *end) {
+    p = skip_blanks(p, end);
+    bool ok = true;
+    if (is_record(p, end, "v")) {
+        Vec3f v;
+        ok = parse_floats(p + 2, end, v.raw, 3);
+        vert_storage_.push_back(v);
+        nverts_++;
+        if (ok && vert_storage_.size() >= spill_limit_ && !spill_positions()) {
+            failed_ = true;
+            return false;
+        }
+    } else if (is_record(p, end, "vt")) {
+        ntexcoords_++;
+    } else if (is_record(p, end, "vn")) {
+        nnormals_++;
+    } else if (is_record(p, end, "f")) {
+        ObjCounts read;
+        read.positions = nverts_;
+        read.texcoords = ntexcoords_;
+        read.normals = nnormals_;
+        ok = parse_face(p + 2, end, read, polygon_, corners_);
+    }
+    if (!ok)
+        std::cerr << filename_ << ":" << line_number_ << ": malformed record" << std::endl;
+    return ok;
+}
+
+bool ModelStream::next_obj_batch() {
+    corners_.clear();
+    while (corners_.size() < batch_triangles_ * 3) {
+        if (block_pos_ == block_end_) {
+            if (have_block_) reader_->release();
+            const char *data;
+            std::size_t size;
+            have_block_ = reader_->next(data, size);
+            if (!have_block_) {
+                // a last line without a newline
+                if (!carry_.empty()) {
+                    line_number_++;
+                    failed_ = !parse_line(carry_.data(), carry_.data() + carry_.size());
+                    carry_.clear();
+                }
+                failed_ = failed_ || reader_->failed();
+                break;
+            }
+            block_pos_ = data;
+            block_end_ = data + size;
+        }
+
+        const char *nl = static_cast<const char *>(std::memchr(block_pos_, '\n', block_end_ - block_pos_));
+        if (!nl) {
+            carry_.append(block_pos_, block_end_);
+            block_pos_ = block_end_;
+            continue;
+        }
+        line_number_++;
+        bool ok;
+        if (carry_.empty()) {
+            ok = parse_line(block_pos_, nl);
+        } else {
+            carry_.append(block_pos_, nl);
+            ok = parse_line(carry_.data(), carry_.data() + carry_.size());
+            carry_.clear();
+        }
+        block_pos_ = nl + 1;
+        if (!ok) {
+            failed_ = true;
+            break;
+        }
+    }
+    if (failed_ || !map_positions()) {
+        failed_ = true;
+        return false;
+    }
+
+    triangles_.resize(corners_.size());
+    for (std::size_t i=0; i<corners_.size(); i++)
+        triangles_[i] = corners_[i].v;
+    return !triangles_.empty();
+}
+
+bool ModelStream::next_cache_batch() {
+    const char *data;
+    std::size_t size;
+    if (!reader_->next(data, size)) {
+        failed_ = reader_->failed();
+        return false;
+    }
+    const std::size_t count = indices16_ ? size / 2 : size / 4;
+    triangles_.resize(count);
+    if (indices16_) {
+        for (std::size_t i=0; i<count; i++) {
+            std::uint16_t index;
+            std::memcpy(&index, data + 2 * i, sizeof(index));
+            triangles_[i] = index;
+        }
+    } else {
+        std::memcpy(triangles_.data(), data, count * sizeof(std::uint32_t));
+    }
+    // copied out, the reader can go on with the next block meanwhile
+    reader_->release();
+
+    for (std::uint32_t index : triangles_) {
+        if (index >= verts_.size()) {
+            std::cerr << filename_ << ": vertex index out of range" << std::endl;
+            failed_ = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ModelStream::next_batch() {
+    if (failed_ || !initialized) return false;
+    return cache_ ? next_cache_batch() : next_obj_batch();
+}
+
+std::span<const Vec3f> ModelStream::verts() const {
+    return verts_;
+}
+
+std::span<const std::uint32_t> ModelStream::triangles() const {
+    return triangles_;
+}
+
+bool ModelStream::failed() const {
+    return failed_;
+}
@@ -1,20 +1,134 @@
 #ifndef __MODEL_H__
 #define __MODEL_H__
 
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <span>
+#include <string>
 #include <vector>
 #include "geometry.h"
+#include "parallel.h"
+
+class MappedFile;
+class BlockReader;
+struct ObjCorner;
 
 class Model {
 private:
-	std::vector<Vec3f> verts_;
-	std::vector<std::vector<int> > faces_;
+	// one entry per distinct (v, vt, vn) corner of the obj file, uvs_ and
+	// normals_ stay empty when no face references a vt or vn. The spans point
+	// into the vectors below after parsing the obj, or straight into the
+	// mapped mesh cache.
+	std::span<const Vec3f> verts_;
+	std::span<const Vec2f> uvs_;
+	std::span<const Vec3f> normals_;
+	// three vertex indices per triangle, 16 bit when every vertex fits
+	std::span<const std::uint16_t> indices16_;
+	std::span<const std::uint32_t> indices32_;
+	Vec3f bounds_min_, bounds_max_;
+
+	std::vector<Vec3f> vert_storage_;
+	std::vector<Vec2f> uv_storage_;
+	std::vector<Vec3f> normal_storage_;
+	std::vector<std::uint16_t> index16_storage_;
+	std::vector<std::uint32_t> index32_storage_;
+	std::unique_ptr<MappedFile> cache_;
+
+	bool load_obj(const char *filename, ParallelFor parallel_for);
+	bool load_cache(const std::string &path, std::uint64_t source_size, std::int64_t source_time, bool verify);
+	void write_cache(const std::string &path, std::uint64_t source_size, std::int64_t source_time) const;
 public:
-	Model(const char *filename);
+	// use_cache reads <filename>.mesh when it is up to date with the obj and
+	// writes it otherwise. Only the cache header and the range of the indices
+	// are checked unless verify_cache is set, which also hashes every stream
+	// (reading the whole file). The obj is parsed again when a check fails. Large obj files
+	// are parsed in chunks through parallel_for (see parallel.h).
+	Model(const char *filename, bool use_cache = true, bool verify_cache = false, ParallelFor parallel_for = serial_for);
 	~Model();
-	int nverts();
-	int nfaces();
-	Vec3f vert(int i);
-	std::vector<int> face(int idx);
+	Model(const Model &) = delete;
+	Model &operator=(const Model &) = delete;
+	int nverts() const;
+	int nfaces() const; // triangles, polygons are split into fans on load
+	int ntriangles() const;
+	Vec3f vert(int i) const;
+	Vec2f uv(int i) const; // zero when the model or the corner has none
+	Vec3f normal(int i) const;
+	std::array<std::uint32_t, 3> triangle(int idx) const;
+	Vec3f bounds_min() const;
+	Vec3f bounds_max() const;
+
+	std::span<const Vec3f> verts() const;
+	bool has_uvs() const;
+	bool has_normals() const;
+	std::span<const Vec2f> uvs() const;
+	std::span<const Vec3f> normals() const;
+	// exactly one of the two is non-empty for a model with triangles
+	bool has_indices16() const;
+	std::span<const std::uint16_t> indices16() const;
+	std::span<const std::uint32_t> indices32() const;
+
+	bool initialized = false;
+	bool from_cache = false; // loaded from the mesh cache, nothing parsed
+};
+
+// Reads a model a batch of triangles at a time, for meshes that do not fit
+// in memory. The file (the obj text, or the index stream of a mesh cache) is
+// read in blocks of block_bytes on a background thread, two blocks in flight,
+// so reading overlaps with whatever the caller does with a batch. Positions
+// stay available for the whole stream without counting against the memory
+// the stream holds: a cache's are mapped, an obj's are kept in memory up to
+// block_bytes and beyond that appended to a temporary file that is mapped
+// in their place. Both mappings are paged in and out by the os.
+class ModelStream {
+private:
+	std::unique_ptr<MappedFile> cache_;
+	std::unique_ptr<BlockReader> reader_;
+	std::span<const Vec3f> verts_;
+	// obj positions: the ones not spilled yet, then the temporary file
+	std::vector<Vec3f> vert_storage_;
+	std::size_t nverts_ = 0; // read so far, spilled ones first
+	std::size_t spill_limit_ = 0; // vert_storage_ entries kept in memory
+	std::string spill_path_; // empty until the first spill
+	std::FILE *spill_ = nullptr; // open while positions are appended
+	std::unique_ptr<MappedFile> spill_map_;
+	std::vector<std::uint32_t> triangles_;
+	std::size_t batch_triangles_;
+	bool indices16_ = false;
+	bool failed_ = false;
+
+	// obj text state, a line cut by the end of a block waits in carry_
+	const char *block_pos_ = nullptr;
+	const char *block_end_ = nullptr;
+	bool have_block_ = false;
+	std::string carry_;
+	std::size_t line_number_ = 0;
+	std::size_t ntexcoords_ = 0, nnormals_ = 0;
+	std::vector<ObjCorner> polygon_, corners_;
+	std::string filename_;
+
+	bool open_cache(const std::string &path, std::uint64_t source_size, std::int64_t source_time);
+	bool spill_positions();
+	bool map_positions();
+	bool parse_line(const char *p, const char *end);
+	bool next_obj_batch();
+	bool next_cache_batch();
+public:
+	// filename is an obj (read through its up to date <filename>.mesh when
+	// there is one and use_cache is set) or a mesh cache. Caches are never
+	// written while streaming.
+	ModelStream(const char *filename, std::size_t block_bytes, std::size_t batch_triangles, bool use_cache = true);
+	~ModelStream();
+	ModelStream(const ModelStream &) = delete;
+	ModelStream &operator=(const ModelStream &) = delete;
+
+	// Reads the next batch, false at the end of the file or on an error.
+	// Both spans are valid until the next call.
+	bool next_batch();
+	std::span<const Vec3f> verts() const; // every vertex read so far
+	std::span<const std::uint32_t> triangles() const; // three vertex indices each
+	bool failed() const;
 
 	bool initialized = false;
 };
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+// tinyrenderer has no threads of its own. Large reads and writes are cut into
+// ranges and handed to a parallel_for the application passes in, which runs
+// fn(first, last) over [0, count) in ranges of about grain items and returns
+// once all of them ran. serial_for, the default, runs them on the caller.
+using RangeFn = std::function<void(std::uint32_t first, std::uint32_t last)>;
+using ParallelFor = void (*)(std::uint32_t count, std::uint32_t grain, const RangeFn &fn);
+
+inline void serial_for(const std::uint32_t count, const std::uint32_t, const RangeFn &fn) {
+    if (count) fn(0, count);
+}
@@ -1,39 +1,54 @@
+#include <algorithm>
 #include <iostream>
 #include <cstring>
 #include "tgaimage.h"
+#include "mapped_file.h"
 
-TGAImage::TGAImage(const int w, const int h, const int bpp) : w(w), h(h), bpp(bpp), data(w*h*bpp, 0) {}
+TGAImage::TGAImage(const int w, const int h, const int bpp) : w(w), h(h), bpp(bpp), data(w*h*bpp, 0), row_stride(w*bpp), pixel_stride(bpp) {}
 
 bool TGAImage::read_tga_file(const std::string filename) {
-    std::ifstream in;
-    in.open(filename, std::ios::binary);
-    if (!in.is_open()) {
+    // the whole file is mapped, packets are decoded straight out of it:
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(filename)) {
         std::cerr << "can't open file " << filename << "\n";
         return false;
     }
     TGAHeader header;
-    in.read(reinterpret_cast<char *>(&header), sizeof(header));
-    if (!in.good()) {
+    if (file->size() < sizeof(header)) {
         std::cerr << "an error occured while reading the header\n";
         return false;
     }
-    w   = header.width;
-    h   = header.height;
-    bpp = header.bitsperpixel>>3;
-    if (w<=0 || h<=0 || (bpp!=GRAYSCALE && bpp!=RGB && bpp!=RGBA)) {
+    std::memcpy(&header, file->data(), sizeof(header));
+    const int width = header.width;
+    const int height = header.height;
+    const int bytespp = header.bitsperpixel>>3;
+    if (width<=0 || height<=0 || (bytespp!=GRAYSCALE && bytespp!=RGB && bytespp!=RGBA)) {
         std::cerr << "bad bpp (or width/height) value\n";
         return false;
     }
-    size_t nbytes = bpp*w*h;
-    data = std::vector<std::uint8_t>(nbytes, 0);
+    // the image id and the color map come before the pixels
+    size_t offset = sizeof(header) + header.idlength;
+    if (header.colormaptype)
+        offset += size_t(header.colormaplength) * ((header.colormapdepth+7)>>3);
+    offset = std::min(offset, file->size());
+    const size_t nbytes = size_t(bytespp)*width*height;
+
+    TGAImage image;
+    image.w = width;
+    image.h = height;
+    image.bpp = bytespp;
     if (3==header.datatypecode || 2==header.datatypecode) {
-        in.read(reinterpret_cast<char *>(data.data()), nbytes);
-        if (!in.good()) {
+        if (file->size()-offset < nbytes) {
             std::cerr << "an error occured while reading the data\n";
             return false;
         }
+        // used in place, pages are only read where the image is sampled:
+        file->advise_random();
+        image.origin = offset;
+        image.mapping = std::move(file);
     } else if (10==header.datatypecode||11==header.datatypecode) {
-        if (!load_rle_data(in)) {
+        image.data.resize(nbytes); // every byte is decoded, no zero-fill
+        if (!image.load_rle_data(file->data()+offset, file->data()+file->size())) {
             std::cerr << "an error occured while reading the data\n";
             return false;
         }
@@ -41,180 +56,272 @@ bool TGAImage::read_tga_file(const std::string filename) {
         std::cerr << "unknown file format " << (int)header.datatypecode << "\n";
         return false;
     }
+    // pixels are kept in file order, the orientation goes into the strides:
+    image.row_stride = std::ptrdiff_t(bytespp)*width;
+    image.pixel_stride = bytespp;
     if (!(header.imagedescriptor & 0x20))
-        flip_vertically();
+        image.flip_vertically();
     if (header.imagedescriptor & 0x10)
-        flip_horizontally();
-    std::cerr << w << "x" << h << "/" << bpp*8 << "\n";
+        image.flip_horizontally();
+    *this = std::move(image);
+    std::cerr << std::to_string(w) + "x" + std::to_string(h) + "/" + std::to_string(bpp*8) + "\n";
     return true;
 }
 
-bool TGAImage::load_rle_data(std::ifstream &in) {
-    size_t pixelcount = w*h;
-    size_t currentpixel = 0;
-    size_t currentbyte  = 0;
-    TGAColor colorbuffer;
-    do {
-        std::uint8_t chunkheader = 0;
-        chunkheader = in.get();
-        if (!in.good()) {
+// Stores count copies of a BPP byte pixel. The pattern is 48 bytes, a whole
+// number of 1, 3 and 4 byte pixels, so long runs become three 16 byte vector
+// stores per 48 bytes.
+template <int BPP>
+static void fill_pixels(std::uint8_t *dst, const std::uint8_t *pixel, size_t count) {
+    if constexpr (1 == BPP) {
+        std::memset(dst, pixel[0], count);
+        return;
+    }
+    if (count < 4) {
+        for (size_t i=0; i<count; i++)
+            std::memcpy(dst+i*BPP, pixel, BPP);
+        return;
+    }
+    std::uint8_t pattern[48];
+    for (int i=0; i<48; i++)
+        pattern[i] = pixel[i%BPP];
+    size_t nbytes = count*BPP;
+    for (; nbytes>=sizeof(pattern); nbytes-=sizeof(pattern), dst+=sizeof(pattern))
+        std::memcpy(dst, pattern, sizeof(pattern));
+    std::memcpy(dst, pattern, nbytes);
+}
+
+// Raw packets are copied in 32 byte moves: with the packet size bounded GCC
+// inlines a plain memcpy as a slow byte sequence instead of calling it.
+static void copy_packet(std::uint8_t *dst, const std::uint8_t *src, size_t nbytes) {
+    for (; nbytes>=32; nbytes-=32, dst+=32, src+=32)
+        std::memcpy(dst, src, 32);
+    std::memcpy(dst, src, nbytes);
+}
+
+template <int BPP>
+static bool decode_rle(const std::uint8_t *in, const std::uint8_t *end, std::uint8_t *dst, const size_t pixelcount) {
+    std::uint8_t *const dst_end = dst + pixelcount*BPP;
+    while (dst != dst_end) {
+        if (in == end) {
             std::cerr << "an error occured while reading the data\n";
             return false;
         }
-        if (chunkheader<128) {
-            chunkheader++;
-            for (int i=0; i<chunkheader; i++) {
-                in.read(reinterpret_cast<char *>(colorbuffer.bgra), bpp);
-                if (!in.good()) {
-                    std::cerr << "an error occured while reading the header\n";
-                    return false;
-                }
-                for (int t=0; t<bpp; t++)
-                    data[currentbyte++] = colorbuffer.bgra[t];
-                currentpixel++;
-                if (currentpixel>pixelcount) {
-                    std::cerr << "Too many pixels read\n";
-                    return false;
-                }
-            }
+        const std::uint8_t chunkheader = *in++;
+        const bool run = chunkheader >= 128;
+        const int count = (chunkheader & 127) + 1;
+        const size_t nbytes = size_t(count)*BPP;
+        const size_t packet_bytes = run ? BPP : nbytes;
+        if (size_t(end-in) < packet_bytes) {
+            std::cerr << "an error occured while reading the data\n";
+            return false;
+        }
+        if (nbytes > size_t(dst_end-dst)) {
+            std::cerr << "Too many pixels read\n";
+            return false;
+        }
+        const std::uint8_t *src = in;
+        in += packet_bytes;
+        if (run)
+            fill_pixels<BPP>(dst, src, count);
+        else
+            copy_packet(dst, src, nbytes);
+        dst += nbytes;
+    }
+    return true;
+}
+
+bool TGAImage::load_rle_data(const std::uint8_t *in, const std::uint8_t *end) {
+    const size_t pixelcount = size_t(w)*h;
+    switch (bpp) {
+        case GRAYSCALE: return decode_rle<GRAYSCALE>(in, end, data.data(), pixelcount);
+        case RGB:       return decode_rle<RGB>(in, end, data.data(), pixelcount);
+        default:        return decode_rle<RGBA>(in, end, data.data(), pixelcount);
+    }
+}
+
+// Row y of src left to right, in place when the pixels already run that way
+static const std::uint8_t *view_row(const TGAView &src, const int y, std::uint8_t *scratch) {
+    const std::uint8_t *row = src.pixel(0, y);
+    if (src.pixel_stride == src.bpp)
+        return row;
+    for (int x=0; x<src.w; x++)
+        std::memcpy(scratch+size_t(x)*src.bpp, row+x*src.pixel_stride, src.bpp);
+    return scratch;
+}
+
+static constexpr int ms_max_packet = 128;
+static constexpr int ms_band_rows = 16;
+
+template <int BPP>
+static bool same_pixel(const std::uint8_t *a, const std::uint8_t *b) {
+    return 0 == std::memcmp(a, b, BPP);
+}
+
+// Packets restart with every row, so rows compress independently. A packet
+// whose first two pixels match is a run. A raw packet is only broken where a
+// run saves bytes: two equal 3 or 4 byte pixels cost 2*BPP bytes inside it and
+// 2+BPP as a run plus a new raw header, for grayscale it takes three.
+template <int BPP>
+static std::uint8_t *encode_rle_row(const std::uint8_t *row, const int w, std::uint8_t *out) {
+    constexpr int min_run = BPP > 2 ? 2 : 3;
+    int x = 0;
+    while (x < w) {
+        const int max = std::min(w-x, ms_max_packet);
+        const std::uint8_t *first = row + size_t(x)*BPP;
+        int n = 1;
+        if (n < max && same_pixel<BPP>(first, first+BPP)) {
+            while (n < max && same_pixel<BPP>(first, first+size_t(n)*BPP))
+                n++;
+            *out++ = std::uint8_t(n+127);
+            std::memcpy(out, first, BPP);
+            out += BPP;
         } else {
-            chunkheader -= 127;
-            in.read(reinterpret_cast<char *>(colorbuffer.bgra), bpp);
-            if (!in.good()) {
-                std::cerr << "an error occured while reading the header\n";
-                return false;
-            }
-            for (int i=0; i<chunkheader; i++) {
-                for (int t=0; t<bpp; t++)
-                    data[currentbyte++] = colorbuffer.bgra[t];
-                currentpixel++;
-                if (currentpixel>pixelcount) {
-                    std::cerr << "Too many pixels read\n";
-                    return false;
-                }
+            for (; n < max; n++) {
+                const std::uint8_t *p = first + size_t(n)*BPP;
+                if (x+n+min_run > w || !same_pixel<BPP>(p, p+BPP))
+                    continue;
+                if (2 == min_run || same_pixel<BPP>(p, p+2*BPP))
+                    break;
             }
+            *out++ = std::uint8_t(n-1);
+            std::memcpy(out, first, size_t(n)*BPP);
+            out += size_t(n)*BPP;
         }
-    } while (currentpixel < pixelcount);
-    return true;
+        x += n;
+    }
+    return out;
+}
+
+static std::uint8_t *encode_rle_row(const std::uint8_t *row, const int w, const int bpp, std::uint8_t *out) {
+    switch (bpp) {
+        case TGAImage::GRAYSCALE: return encode_rle_row<TGAImage::GRAYSCALE>(row, w, out);
+        case TGAImage::RGB:       return encode_rle_row<TGAImage::RGB>(row, w, out);
+        default:                  return encode_rle_row<TGAImage::RGBA>(row, w, out);
+    }
 }
 
-bool TGAImage::write_tga_file(const std::string filename, const bool vflip, const bool rle) const {
+// Encodes the whole file into memory and writes it at once. Bands of rows are
+// encoded through parallel_for, uncompressed rows straight into the file buffer
+// and compressed ones into a buffer per band that is appended afterwards.
+// row(y, scratch) returns row y in file byte order, converted into scratch
+// (w*bpp bytes) when the source is laid out differently.
+template <typename RowFn>
+static bool write_tga(const std::string &filename, const int w, const int h, const int bpp, const bool vflip, const bool rle, ParallelFor parallel_for, const RowFn &row) {
     constexpr std::uint8_t developer_area_ref[4] = {0, 0, 0, 0};
     constexpr std::uint8_t extension_area_ref[4] = {0, 0, 0, 0};
     constexpr std::uint8_t footer[18] = {'T','R','U','E','V','I','S','I','O','N','-','X','F','I','L','E','.','\0'};
-    std::ofstream out;
-    out.open(filename, std::ios::binary);
-    if (!out.is_open()) {
-        std::cerr << "can't open file " << filename << "\n";
-        return false;
-    }
     TGAHeader header = {};
     header.bitsperpixel = bpp<<3;
     header.width  = w;
     header.height = h;
-    header.datatypecode = (bpp==GRAYSCALE?(rle?11:3):(rle?10:2));
+    header.datatypecode = (bpp==TGAImage::GRAYSCALE?(rle?11:3):(rle?10:2));
     header.imagedescriptor = vflip ? 0x00 : 0x20; // top-left or bottom-left origin
-    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
-    if (!out.good()) {
-        std::cerr << "can't dump the tga file\n";
-        return false;
-    }
+
+    const size_t row_bytes = size_t(w)*bpp;
+    const std::uint32_t nbands = std::uint32_t((h+ms_band_rows-1)/ms_band_rows);
+    std::vector<std::uint8_t, default_init_allocator<std::uint8_t>> file;
     if (!rle) {
-        out.write(reinterpret_cast<const char *>(data.data()), w*h*bpp);
-        if (!out.good()) {
-            std::cerr << "can't unload raw data\n";
-            return false;
-        }
-    } else if (!unload_rle_data(out)) {
-            std::cerr << "can't unload rle data\n";
-            return false;
+        file.resize(sizeof(header) + row_bytes*h);
+        std::uint8_t *pixels = file.data() + sizeof(header);
+        parallel_for(std::uint32_t(h), ms_band_rows, [&](std::uint32_t first, std::uint32_t last) {
+            for (std::uint32_t y=first; y<last; y++) {
+                std::uint8_t *dst = pixels + y*row_bytes;
+                const std::uint8_t *src = row(int(y), dst);
+                if (src != dst)
+                    std::memcpy(dst, src, row_bytes);
+            }
+        });
+    } else {
+        const size_t max_row_bytes = row_bytes + w/ms_max_packet + 1;
+        std::vector<std::vector<std::uint8_t, default_init_allocator<std::uint8_t>>> bands(nbands);
+        parallel_for(std::uint32_t(h), ms_band_rows, [&](std::uint32_t first, std::uint32_t last) {
+            std::vector<std::uint8_t, default_init_allocator<std::uint8_t>> scratch(row_bytes);
+            for (std::uint32_t band=first/ms_band_rows; band*ms_band_rows<last; band++) {
+                const std::uint32_t y0 = band*ms_band_rows;
+                const std::uint32_t y1 = std::min(y0+ms_band_rows, last);
+                auto &out = bands[band];
+                out.resize(max_row_bytes*(y1-y0));
+                std::uint8_t *end = out.data();
+                for (std::uint32_t y=y0; y<y1; y++)
+                    end = encode_rle_row(row(int(y), scratch.data()), w, bpp, end);
+                out.resize(size_t(end-out.data()));
+            }
+        });
+        size_t nbytes = sizeof(header);
+        for (const auto &band : bands)
+            nbytes += band.size();
+        file.resize(nbytes);
+        std::uint8_t *dst = file.data() + sizeof(header);
+        for (const auto &band : bands) {
+            std::memcpy(dst, band.data(), band.size());
+            dst += band.size();
         }
-    out.write(reinterpret_cast<const char *>(developer_area_ref), sizeof(developer_area_ref));
-    if (!out.good()) {
-        std::cerr << "can't dump the tga file\n";
-        return false;
     }
-    out.write(reinterpret_cast<const char *>(extension_area_ref), sizeof(extension_area_ref));
-    if (!out.good()) {
-        std::cerr << "can't dump the tga file\n";
+    std::memcpy(file.data(), &header, sizeof(header));
+    file.insert(file.end(), developer_area_ref, developer_area_ref+sizeof(developer_area_ref));
+    file.insert(file.end(), extension_area_ref, extension_area_ref+sizeof(extension_area_ref));
+    file.insert(file.end(), footer, footer+sizeof(footer));
+
+    std::ofstream out;
+    out.open(filename, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "can't open file " << filename << "\n";
         return false;
     }
-    out.write(reinterpret_cast<const char *>(footer), sizeof(footer));
-    if (!out.good()) {
+    out.write(reinterpret_cast<const char *>(file.data()), file.size());
+    // the data may still sit in the stream buffer, errors flushing it (disk
+    // full, quota) only show up on close
+    out.close();
+    if (out.fail()) {
         std::cerr << "can't dump the tga file\n";
         return false;
     }
     return true;
 }
 
-// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
-bool TGAImage::unload_rle_data(std::ofstream &out) const {
-    const std::uint8_t max_chunk_length = 128;
-    size_t npixels = w*h;
-    size_t curpix = 0;
-    while (curpix<npixels) {
-        size_t chunkstart = curpix*bpp;
-        size_t curbyte = curpix*bpp;
-        std::uint8_t run_length = 1;
-        bool raw = true;
-        while (curpix+run_length<npixels && run_length<max_chunk_length) {
-            bool succ_eq = true;
-            for (int t=0; succ_eq && t<bpp; t++)
-                succ_eq = (data[curbyte+t]==data[curbyte+t+bpp]);
-            curbyte += bpp;
-            if (1==run_length)
-                raw = !succ_eq;
-            if (raw && succ_eq) {
-                run_length--;
-                break;
-            }
-            if (!raw && !succ_eq)
-                break;
-            run_length++;
-        }
-        curpix += run_length;
-        out.put(raw?run_length-1:run_length+127);
-        if (!out.good()) {
-            std::cerr << "can't dump the tga file\n";
-            return false;
-        }
-        out.write(reinterpret_cast<const char *>(data.data()+chunkstart), (raw?run_length*bpp:bpp));
-        if (!out.good()) {
-            std::cerr << "can't dump the tga file\n";
-            return false;
+bool TGAImage::write_tga_file(const std::string filename, const bool vflip, const bool rle, ParallelFor parallel_for) const {
+    const TGAView src = view();
+    return write_tga(filename, w, h, bpp, vflip, rle, parallel_for, [&](int y, std::uint8_t *scratch) {
+        return view_row(src, y, scratch);
+    });
+}
+
+bool TGAImage::write_tga_file(const std::string filename, const std::uint32_t *rgba, const int w, const int h, const bool vflip, const bool rle, ParallelFor parallel_for) {
+    return write_tga(filename, w, h, RGBA, vflip, rle, parallel_for, [&](int y, std::uint8_t *scratch) {
+        // RGBA8 texels to the BGRA bytes of the file, red and blue swap:
+        const std::uint32_t *src = rgba + size_t(y)*w;
+        for (int x=0; x<w; x++) {
+            const std::uint32_t p = src[x];
+            const std::uint32_t bgra = (p & 0xff00ff00u) | ((p>>16) & 0xffu) | ((p & 0xffu)<<16);
+            std::memcpy(scratch+size_t(x)*4, &bgra, 4);
         }
-    }
-    return true;
+        return static_cast<const std::uint8_t *>(scratch);
+    });
 }
 
 TGAColor TGAImage::get(const int x, const int y) const {
-    if (!data.size() || x<0 || y<0 || x>=w || y>=h)
+    if (x<0 || y<0 || x>=w || y>=h)
         return {};
     TGAColor ret = {0, 0, 0, 0, bpp};
-    const std::uint8_t *p = data.data()+(x+y*w)*bpp;
-    for (int i=bpp; i--; ret.bgra[i] = p[i]);
+    std::memcpy(ret.bgra, view().pixel(x, y), bpp);
     return ret;
 }
 
 void TGAImage::set(int x, int y, const TGAColor &c) {
-    if (!data.size() || x<0 || y<0 || x>=w || y>=h) return;
-    memcpy(data.data()+(x+y*w)*bpp, c.bgra, bpp);
+    if (x<0 || y<0 || x>=w || y>=h) return;
+    own_pixels();
+    memcpy(data.data()+origin+y*row_stride+x*pixel_stride, c.bgra, bpp);
 }
 
 void TGAImage::flip_horizontally() {
-    int half = w>>1;
-    for (int i=0; i<half; i++)
-        for (int j=0; j<h; j++)
-            for (int b=0; b<bpp; b++)
-                std::swap(data[(i+j*w)*bpp+b], data[(w-1-i+j*w)*bpp+b]);
+    origin += (w-1)*pixel_stride;
+    pixel_stride = -pixel_stride;
 }
 
 void TGAImage::flip_vertically() {
-    int half = h>>1;
-    for (int i=0; i<w; i++)
-        for (int j=0; j<half; j++)
-            for (int b=0; b<bpp; b++)
-                std::swap(data[(i+j*w)*bpp+b], data[(i+(h-1-j)*w)*bpp+b]);
+    origin += (h-1)*row_stride;
+    row_stride = -row_stride;
 }
 
 int TGAImage::width() const {
@@ -225,4 +332,28 @@ int TGAImage::height() const {
     return h;
 }
 
+TGAView TGAImage::view() const {
+    const std::uint8_t *base = mapping ? mapping->data() : data.data();
+    return {base+origin, row_stride, pixel_stride, w, h, bpp};
+}
+
+// Copies mapped pixels into data, top row first, before the first write
+void TGAImage::own_pixels() {
+    if (!mapping)
+        return;
+    const TGAView src = view();
+    const size_t row_bytes = size_t(w)*bpp;
+    std::vector<std::uint8_t, default_init_allocator<std::uint8_t>> pixels(row_bytes*h);
+    for (int y=0; y<h; y++) {
+        std::uint8_t *dst = pixels.data() + y*row_bytes;
+        const std::uint8_t *row = view_row(src, y, dst);
+        if (row != dst)
+            std::memcpy(dst, row, row_bytes);
+    }
+    data.swap(pixels);
+    mapping.reset();
+    origin = 0;
+    row_stride = std::ptrdiff_t(row_bytes);
+    pixel_stride = bpp;
+}
 
@@ -1,7 +1,15 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#include "parallel.h"
 
 #pragma pack(push,1)
 struct TGAHeader {
@@ -26,26 +34,215 @@ struct TGAColor {
     std::uint8_t& operator[](const int i) { return bgra[i]; }
 };
 
+// Leaves elements it grows a vector by uninitialized (value-initialization
+// is still honoured), for buffers the decoder overwrites completely anyway.
+template <typename T>
+struct default_init_allocator : std::allocator<T> {
+    template <typename U> struct rebind { using other = default_init_allocator<U>; };
+    default_init_allocator() = default;
+    template <typename U> default_init_allocator(const default_init_allocator<U> &) noexcept {}
+    template <typename U> void construct(U *p) noexcept { ::new (static_cast<void *>(p)) U; }
+    template <typename U, typename... Args> void construct(U *p, Args &&...args) { ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...); }
+};
+
+class MappedFile;
+
+// Where the pixels of an image are: pixel (x, y) starts at
+// origin + y*row_stride + x*pixel_stride. Flipping an image moves the origin
+// to another corner and negates a stride, no pixel moves.
+struct TGAView {
+    const std::uint8_t *origin = nullptr;
+    std::ptrdiff_t row_stride = 0;
+    std::ptrdiff_t pixel_stride = 0;
+    int w = 0;
+    int h = 0;
+    int bpp = 0;
+
+    const std::uint8_t *pixel(const int x, const int y) const { return origin + y*row_stride + x*pixel_stride; }
+};
+
+// Pixel layouts of the three tga formats, channels in file order (color is
+// stored blue first)
+struct Gray8 { std::uint8_t v; };
+struct RGB8  { std::uint8_t b, g, r; };
+struct BGRA8 { std::uint8_t b, g, r, a; };
+static_assert(1==sizeof(Gray8) && 3==sizeof(RGB8) && 4==sizeof(BGRA8));
+
+inline BGRA8 to_bgra8(const Gray8 p) { return {p.v, p.v, p.v, 255}; }
+inline BGRA8 to_bgra8(const RGB8 p)  { return {p.b, p.g, p.r, 255}; }
+inline BGRA8 to_bgra8(const BGRA8 p) { return p; }
+
+// Gray fills the color channels, color turns gray with the Rec. 601 luma
+// weights, alpha is 255 where the source has none
+template <typename To, typename From>
+To convert_pixel(const From p) {
+    if constexpr (std::is_same_v<To, From>) {
+        return p;
+    } else {
+        const BGRA8 c = to_bgra8(p);
+        if constexpr (std::is_same_v<To, Gray8>)
+            return {std::uint8_t((77*c.r + 150*c.g + 29*c.b + 128) >> 8)};
+        else if constexpr (std::is_same_v<To, RGB8>)
+            return {c.b, c.g, c.r};
+        else
+            return c;
+    }
+}
+
+template <typename To, typename From>
+void convert_pixels(const From *src, To *dst, const std::size_t count) {
+    if constexpr (std::is_same_v<To, From>) {
+        std::memcpy(dst, src, count*sizeof(From));
+    } else {
+        for (std::size_t i=0; i<count; i++)
+            dst[i] = convert_pixel<To>(src[i]);
+    }
+}
+
+// TGAView with the format fixed at compile time, writable unless Pixel is
+// const. Rows are spans as long as the pixels run left to right in memory,
+// which only a horizontal flip changes; get/set and the row copies work in
+// every orientation.
+template <typename Pixel>
+struct TGAPixels {
+    using value_type = std::remove_const_t<Pixel>;
+    using byte_type = std::conditional_t<std::is_const_v<Pixel>, const std::uint8_t, std::uint8_t>;
+    static constexpr int bpp = sizeof(value_type);
+
+    byte_type *origin = nullptr;
+    std::ptrdiff_t row_stride = 0;
+    std::ptrdiff_t pixel_stride = 0;
+    int w = 0;
+    int h = 0;
+
+    // false when the image has another format (or no pixels)
+    explicit operator bool() const { return nullptr != origin; }
+    bool contiguous_rows() const { return bpp == pixel_stride; }
+
+    // only while contiguous_rows()
+    std::span<Pixel> row(const int y) const {
+        return {reinterpret_cast<Pixel *>(origin + y*row_stride), std::size_t(w)};
+    }
+    value_type get(const int x, const int y) const {
+        value_type p;
+        std::memcpy(&p, origin + y*row_stride + x*pixel_stride, bpp);
+        return p;
+    }
+    void set(const int x, const int y, const value_type p) const requires (!std::is_const_v<Pixel>) {
+        std::memcpy(origin + y*row_stride + x*pixel_stride, &p, bpp);
+    }
+
+    // row y left to right, w pixels converted to To
+    template <typename To>
+    void read_row(const int y, To *dst) const {
+        if (contiguous_rows()) {
+            convert_pixels(row(y).data(), dst, w);
+            return;
+        }
+        for (int x=0; x<w; x++)
+            dst[x] = convert_pixel<To>(get(x, y));
+    }
+    template <typename From>
+    void write_row(const int y, const From *src) const requires (!std::is_const_v<Pixel>) {
+        if (contiguous_rows()) {
+            convert_pixels(src, row(y).data(), w);
+            return;
+        }
+        for (int x=0; x<w; x++)
+            set(x, y, convert_pixel<value_type>(src[x]));
+    }
+};
+
 struct TGAImage {
     enum Format { GRAYSCALE=1, RGB=3, RGBA=4 };
 
     TGAImage() = default;
     TGAImage(const int w, const int h, const int bpp);
     bool  read_tga_file(const std::string filename);
-    bool write_tga_file(const std::string filename, const bool vflip=true, const bool rle=true) const;
+    // parallel_for encodes bands of rows at once (see parallel.h)
+    bool write_tga_file(const std::string filename, const bool vflip=true, const bool rle=true, ParallelFor parallel_for=serial_for) const;
+    // Writes a w x h image of RGBA8 texels (red in the low byte) as a 32 bit
+    // tga, without building a TGAImage first
+    static bool write_tga_file(const std::string filename, const std::uint32_t *rgba, const int w, const int h, const bool vflip=true, const bool rle=true, ParallelFor parallel_for=serial_for);
     void flip_horizontally();
     void flip_vertically();
     TGAColor get(const int x, const int y) const;
     void set(const int x, const int y, const TGAColor &c);
     int width()  const;
     int height() const;
+    TGAView view() const;
+    // Typed access, an empty view unless Pixel has the image's bytes per
+    // pixel. Reading never copies a mapped image, writing copies it first.
+    template <typename Pixel> TGAPixels<const Pixel> pixels() const;
+    template <typename Pixel> TGAPixels<Pixel> mutable_pixels();
+    // Calls fn with the typed view of the image's format (Gray8, RGB8 or BGRA8)
+    template <typename Fn> decltype(auto) visit_pixels(Fn &&fn) const;
+    // All w*h pixels top row first, converted to To / from From
+    template <typename To> void read_pixels(To *dst) const;
+    template <typename From> void write_pixels(const From *src);
+    // true while the pixels are read in place from the file
+    bool is_mapped() const { return nullptr != mapping; }
 private:
-    bool   load_rle_data(std::ifstream &in);
-    bool unload_rle_data(std::ofstream &out) const;
+    bool   load_rle_data(const std::uint8_t *in, const std::uint8_t *end);
+    void own_pixels();
 
     int w = 0;
     int h = 0;
     std::uint8_t bpp = 0;
-    std::vector<std::uint8_t> data = {};
+    std::vector<std::uint8_t, default_init_allocator<std::uint8_t>> data = {};
+
+    // Uncompressed files are not copied: the pixels stay in the mapping
+    // (shared by copies of the image, data stays empty) until set() writes.
+    std::shared_ptr<const MappedFile> mapping = {};
+
+    // pixel (0, 0) as an offset into the mapping or data, see TGAView
+    std::ptrdiff_t origin = 0;
+    std::ptrdiff_t row_stride = 0;
+    std::ptrdiff_t pixel_stride = 0;
 };
 
+template <typename Pixel>
+TGAPixels<const Pixel> TGAImage::pixels() const {
+    if (int(sizeof(Pixel)) != bpp)
+        return {};
+    const TGAView v = view();
+    return {v.origin, v.row_stride, v.pixel_stride, w, h};
+}
+
+template <typename Pixel>
+TGAPixels<Pixel> TGAImage::mutable_pixels() {
+    if (int(sizeof(Pixel)) != bpp)
+        return {};
+    own_pixels();
+    return {data.data()+origin, row_stride, pixel_stride, w, h};
+}
+
+template <typename Fn>
+decltype(auto) TGAImage::visit_pixels(Fn &&fn) const {
+    switch (bpp) {
+        case GRAYSCALE: return fn(pixels<Gray8>());
+        case RGB:       return fn(pixels<RGB8>());
+        default:        return fn(pixels<BGRA8>());
+    }
+}
+
+template <typename To>
+void TGAImage::read_pixels(To *dst) const {
+    visit_pixels([&](const auto &src) {
+        for (int y=0; y<src.h; y++)
+            src.read_row(y, dst + std::size_t(y)*src.w);
+    });
+}
+
+template <typename From>
+void TGAImage::write_pixels(const From *src) {
+    auto write = [&](const auto &dst) {
+        for (int y=0; y<dst.h; y++)
+            dst.write_row(y, src + std::size_t(y)*dst.w);
+    };
+    switch (bpp) {
+        case GRAYSCALE: write(mutable_pixels<Gray8>()); break;
+        case RGB:       write(mutable_pixels<RGB8>()); break;
+        case RGBA:      write(mutable_pixels<BGRA8>()); break;
+    }
+}
@@ -0,0 +1,383 @@
+// Headless_Rasterizer.cpp : This file contains the 'main' function.
+// Description: offline renderer running the SWC raster pipeline into a plain
+// cpu framebuffer and writing the result as tga, no window or d3d12 needed
+//
+
+#include <RasterCore/Asset_Loader.hpp>
+#include <RasterCore/Pipeline.hpp>
+#include <RasterCore/Profiler.hpp>
+#include <RasterCore/Job_System.hpp>
+#include <RasterCore/Texture.hpp>
+
+#include <tinyrenderer/model.h>
+#include <tinyrenderer/tgaimage.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//---------------------------------------------------------------------------//
+// Command line
+//---------------------------------------------------------------------------//
+enum class RenderMode
+{
+  Wireframe,
+  Flat,
+  Depth,
+  Textured
+};
+//---------------------------------------------------------------------------//
+struct Options
+{
+  std::vector<std::string> inputs;
+  std::string output = "output.tga";
+  std::string tracePrefix;
+  std::string texture; // empty picks <model stem>_diffuse.tga per model
+  int width = 512;
+  int height = 512;
+  RenderMode mode = RenderMode::Depth;
+  Camera camera;
+  bool rle = true;
+  bool stats = false;
+  bool meshCache = true;
+  bool verifyMeshCache = false;
+  size_t streamBudget = 0; // bytes, 0 loads the whole model
+};
+//---------------------------------------------------------------------------//
+static void
+printUsage(const char* p_Exe)
+{
+  fprintf(stderr,
+    "usage: %s [options] <model.obj> [<model.obj> ...]\n"
+    "  -o <path>          output tga, or output directory for several models (default output.tga)\n"
+    "  -w <pixels>        framebuffer width (default 512)\n"
+    "  -h <pixels>        framebuffer height (default 512)\n"
+    "  --mode <m>         wireframe | flat | depth | textured (default depth)\n"
+    "  --texture <tga>    textured only: diffuse map for every model\n"
+    "                     (default <model stem>_diffuse.tga next to each model)\n"
+    "  --eye <x,y,z>      camera position (default 0,0,1)\n"
+    "  --target <x,y,z>   camera look-at point (default 0,0,0)\n"
+    "  --up <x,y,z>       camera up vector (default 0,1,0)\n"
+    "  --scale <s>        camera zoom (default 1)\n"
+    "  --no-rle           write uncompressed tga\n"
+    "  --no-mesh-cache    always parse the obj, don't read or write <model.obj>.mesh\n"
+    "  --verify-mesh-cache\n"
+    "                     hash every stream of the mesh cache, not just its header, and\n"
+    "                     parse the obj again when one doesn't match\n"
+    "  --stream <MB>      flat/depth only: read and render the model in batches within\n"
+    "                     about <MB> of memory, for models too large to load (positions\n"
+    "                     beyond that go to a mapped temporary file)\n"
+    "  --trace <prefix>   write a chrome trace per frame to <prefix>_<frame>.json\n"
+    "                     (needs a build with RASTER_PROFILING)\n"
+    "  --stats            print pipeline statistics per draw and per frame as json lines\n"
+    "  --isa <name>       triangle kernels: scalar | sse4.1 | avx2 | avx512 (default: best the cpu has)\n"
+    "  --traversal <name> block order: rows | tiles | columns (default rows)\n"
+    "  --threads <n>      raster threads, 1 draws on the main thread only (default: one per core)\n",
+    p_Exe);
+}
+//---------------------------------------------------------------------------//
+static bool
+parseVec3(const char* p_Str, Vec3F& p_Out)
+{
+  return 3 == sscanf(p_Str, "%f,%f,%f", &p_Out.x, &p_Out.y, &p_Out.z);
+}
+//---------------------------------------------------------------------------//
+static bool
+parseOptions(int p_Argc, char** p_Argv, Options& p_Options)
+{
+  for (int i = 1; i < p_Argc; ++i)
+  {
+    const char* arg = p_Argv[i];
+    const bool hasValue = i + 1 < p_Argc;
+
+    if (0 == strcmp(arg, "-o") && hasValue)
+      p_Options.output = p_Argv[++i];
+    else if (0 == strcmp(arg, "-w") && hasValue)
+      p_Options.width = atoi(p_Argv[++i]);
+    else if (0 == strcmp(arg, "-h") && hasValue)
+      p_Options.height = atoi(p_Argv[++i]);
+    else if (0 == strcmp(arg, "--mode") && hasValue)
+    {
+      const char* mode = p_Argv[++i];
+      if (0 == strcmp(mode, "wireframe"))
+        p_Options.mode = RenderMode::Wireframe;
+      else if (0 == strcmp(mode, "flat"))
+        p_Options.mode = RenderMode::Flat;
+      else if (0 == strcmp(mode, "depth"))
+        p_Options.mode = RenderMode::Depth;
+      else if (0 == strcmp(mode, "textured"))
+        p_Options.mode = RenderMode::Textured;
+      else
+        return false;
+    }
+    else if (0 == strcmp(arg, "--texture") && hasValue)
+      p_Options.texture = p_Argv[++i];
+    else if (0 == strcmp(arg, "--eye") && hasValue)
+    {
+      if (!parseVec3(p_Argv[++i], p_Options.camera.eye)) return false;
+    }
+    else if (0 == strcmp(arg, "--target") && hasValue)
+    {
+      if (!parseVec3(p_Argv[++i], p_Options.camera.target)) return false;
+    }
+    else if (0 == strcmp(arg, "--up") && hasValue)
+    {
+      if (!parseVec3(p_Argv[++i], p_Options.camera.up)) return false;
+    }
+    else if (0 == strcmp(arg, "--scale") && hasValue)
+      p_Options.camera.scale = (float)atof(p_Argv[++i]);
+    else if (0 == strcmp(arg, "--no-rle"))
+      p_Options.rle = false;
+    else if (0 == strcmp(arg, "--no-mesh-cache"))
+      p_Options.meshCache = false;
+    else if (0 == strcmp(arg, "--verify-mesh-cache"))
+      p_Options.verifyMeshCache = true;
+    else if (0 == strcmp(arg, "--stream") && hasValue)
+    {
+      const int megabytes = atoi(p_Argv[++i]);
+      if (megabytes < 1)
+        return false;
+      p_Options.streamBudget = (size_t)megabytes << 20;
+    }
+    else if (0 == strcmp(arg, "--stats"))
+      p_Options.stats = true;
+    else if (0 == strcmp(arg, "--trace") && hasValue)
+      p_Options.tracePrefix = p_Argv[++i];
+    else if (0 == strcmp(arg, "--isa") && hasValue)
+    {
+      RasterIsa isa;
+      if (!parseRasterIsa(p_Argv[++i], isa))
+        return false;
+      if (!setRasterIsa(isa))
+      {
+        fprintf(stderr, "this cpu does not support %s\n", getRasterIsaName(isa));
+        return false;
+      }
+    }
+    else if (0 == strcmp(arg, "--traversal") && hasValue)
+    {
+      RasterTraversal traversal;
+      if (!parseRasterTraversal(p_Argv[++i], traversal))
+        return false;
+      setRasterTraversal(traversal);
+    }
+    else if (0 == strcmp(arg, "--threads") && hasValue)
+    {
+      const int threads = atoi(p_Argv[++i]);
+      if (threads < 1)
+        return false;
+      JobSystem::setThreadCount((uint32_t)threads);
+    }
+    else if ('-' == arg[0])
+      return false;
+    else
+      p_Options.inputs.push_back(arg);
+  }
+
+  const bool streamable = RenderMode::Flat == p_Options.mode || RenderMode::Depth == p_Options.mode;
+  if (p_Options.streamBudget && !streamable)
+  {
+    fprintf(stderr, "--stream supports the flat and depth modes only\n");
+    return false;
+  }
+  return !p_Options.inputs.empty() && p_Options.width > 0 && p_Options.height > 0;
+}
+//---------------------------------------------------------------------------//
+// Output helpers
+//---------------------------------------------------------------------------//
+static std::string
+outputPathFor(const Options& p_Options, const std::string& p_Input)
+{
+  if (1 == p_Options.inputs.size())
+    return p_Options.output;
+
+  // several models: -o names a directory, one tga per model stem
+  size_t slash = p_Input.find_last_of("/\\");
+  std::string stem = p_Input.substr(std::string::npos == slash ? 0 : slash + 1);
+  size_t dot = stem.find_last_of('.');
+  if (std::string::npos != dot)
+    stem = stem.substr(0, dot);
+
+  return p_Options.output + "/" + stem + ".tga";
+}
+//---------------------------------------------------------------------------//
+static std::string
+texturePathFor(const Options& p_Options, const std::string& p_Input)
+{
+  if (!p_Options.texture.empty())
+    return p_Options.texture;
+
+  // the tinyrenderer assets keep the diffuse map next to the obj:
+  size_t dot = p_Input.find_last_of('.');
+  size_t slash = p_Input.find_last_of("/\\");
+  if (std::string::npos == dot || (std::string::npos != slash && dot < slash))
+    dot = p_Input.size();
+  return p_Input.substr(0, dot) + "_diffuse.tga";
+}
+//---------------------------------------------------------------------------//
+static bool
+writeFramebuffer(const Framebuffer& p_Fb, const std::string& p_Path, bool p_Rle)
+{
+  // the framebuffer is stored top row first, the encoder swaps its RGBA8
+  // texels to BGRA while it compresses the rows:
+  return TGAImage::write_tga_file(p_Path, p_Fb.color, p_Fb.width, p_Fb.height, false, p_Rle, JobSystem::parallelRanges);
+}
+
+//---------------------------------------------------------------------------//
+// Main function
+//---------------------------------------------------------------------------//
+// Models requested ahead of the one being drawn, the loader threads (2 by
+// default) stay busy without queueing the whole command line
+static constexpr size_t ms_Prefetch = 2;
+//---------------------------------------------------------------------------//
+int
+main(int p_Argc, char** p_Argv)
+{
+  Options options;
+  if (!parseOptions(p_Argc, p_Argv, options))
+  {
+    printUsage(p_Argv[0]);
+    return 1;
+  }
+  if (!options.tracePrefix.empty() && !Profiler::ms_Enabled)
+    fprintf(stderr, "built without RASTER_PROFILING, --trace is ignored\n");
+
+  std::vector<uint32_t> colorMemory((size_t)options.width * options.height);
+  std::vector<float> depthMemory((size_t)options.width * options.height);
+
+  Framebuffer fb;
+  fb.width = options.width;
+  fb.height = options.height;
+  fb.color = colorMemory.data();
+  fb.depth = depthMemory.data();
+
+  StatsRecorder stats;
+  if (options.stats)
+    fb.stats = &stats;
+
+  // the next ms_Prefetch models load in the background while the current one
+  // renders, each frame requests one more: a long list of inputs doesn't
+  // keep every mesh in memory at once. Streamed models are read while they
+  // are drawn instead.
+  const size_t count = options.inputs.size();
+  std::vector<AssetHandle<Model>> models(count);
+  std::vector<AssetHandle<Texture>> textures(count);
+  auto request = [&](size_t p_Index) {
+    if (p_Index >= count || 0 != options.streamBudget)
+      return;
+    const std::string& input = options.inputs[p_Index];
+    models[p_Index] = AssetLoader::loadModel(input, options.meshCache, options.verifyMeshCache);
+    if (RenderMode::Textured == options.mode)
+      textures[p_Index] = AssetLoader::loadTexture(texturePathFor(options, input));
+  };
+  // drawn or failed, the assets of input p_Index are not needed any more
+  auto release = [&](size_t p_Index) {
+    models[p_Index] = {};
+    textures[p_Index] = {};
+  };
+  for (size_t m = 0; m < ms_Prefetch; m++)
+    request(m);
+
+  int failures = 0;
+  for (size_t m = 0; m < count; m++)
+  {
+    // one frame per model: load, render and write
+    const std::string& input = options.inputs[m];
+    Profiler::beginFrame();
+    request(m + ms_Prefetch);
+
+    const Model* model = nullptr;
+    if (0 == options.streamBudget)
+    {
+      {
+        RASTER_PROFILE_ZONE("wait load");
+        model = models[m].wait();
+      }
+      if (!model)
+      {
+        fprintf(stderr, "can't load model %s\n", input.c_str());
+        release(m);
+        ++failures;
+        continue;
+      }
+    }
+    const Texture* texture = nullptr;
+    if (RenderMode::Textured == options.mode)
+    {
+      {
+        RASTER_PROFILE_ZONE("wait load");
+        texture = textures[m].wait();
+      }
+      if (!texture)
+      {
+        fprintf(stderr, "can't load texture %s\n", textures[m].getPath().c_str());
+        release(m);
+        ++failures;
+        continue;
+      }
+    }
+
+    clearBuffer(fb, BLACK);
+    clearDepthBuffer(fb);
+    if (fb.stats)
+      fb.stats->beginFrame(fb.width, fb.height);
+
+    fb.flipVertically = true;
+    bool drawn = true;
+    if (model)
+    {
+      switch (options.mode)
+      {
+      case RenderMode::Wireframe: drawModelWireframe(fb, *model, options.camera, WHITE); break;
+      case RenderMode::Flat:      drawModelFlat(fb, *model, options.camera); break;
+      case RenderMode::Depth:     drawModelDepth(fb, *model, options.camera); break;
+      case RenderMode::Textured:  drawModelTextured(fb, *model, *texture, options.camera); break;
+      }
+    }
+    else
+    {
+      const bool depthTest = RenderMode::Depth == options.mode;
+      drawn = drawModelStreamed(fb, input.c_str(), options.camera, depthTest, options.streamBudget, options.meshCache);
+    }
+    fb.flipVertically = false;
+    release(m);
+    if (!drawn)
+    {
+      fprintf(stderr, "can't stream model %s\n", input.c_str());
+      ++failures;
+      continue;
+    }
+
+    if (fb.stats)
+    {
+      printStats(stdout, (input + ":draw").c_str(), stats.lastDraw);
+      printStats(stdout, (input + ":frame").c_str(), stats.frame);
+    }
+
+    const std::string output = outputPathFor(options, input);
+    bool written = false;
+    {
+      RASTER_PROFILE_ZONE("write");
+      written = writeFramebuffer(fb, output, options.rle);
+    }
+    Profiler::endFrame();
+
+    if (Profiler::ms_Enabled && !options.tracePrefix.empty())
+    {
+      std::string tracePath = options.tracePrefix + "_" + std::to_string(Profiler::ms_FrameIndex - 1) + ".json";
+      if (!Profiler::writeChromeTrace(tracePath.c_str()))
+        ++failures;
+    }
+
+    if (!written)
+    {
+      ++failures;
+      continue;
+    }
+    fprintf(stderr, "%s -> %s\n", input.c_str(), output.c_str());
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,660 @@
+// Raster_Bench.cpp : This file contains the 'main' function.
+// Description: microbenchmarks for the hot raster primitives, results are
+// written as json and can be compared against a previous run
+//
+
+#include <RasterCore/Pipeline.hpp>
+#include <RasterCore/Job_System.hpp>
+
+#include <tinyrenderer/model.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifndef RASTER_ASSETS_DIR
+#define RASTER_ASSETS_DIR "../Assets"
+#endif
+
+//---------------------------------------------------------------------------//
+// Benchmark harness
+//---------------------------------------------------------------------------//
+// Hardware events counted around every measured batch (linux perf events)
+enum CounterId
+{
+  CounterL1dMisses,
+  CounterLlcMisses,
+  CounterDtlbMisses,
+  CounterCount
+};
+static const char* ms_CounterNames[CounterCount] = { "l1d_misses", "llc_misses", "dtlb_misses" };
+//---------------------------------------------------------------------------//
+struct BenchResult
+{
+  std::string name;
+  uint64_t iterations = 0;
+  double nsPerOp = 0.0;
+  double pixelsPerOp = 0.0;
+  double trianglesPerOp = 0.0;
+  double countersPerOp[CounterCount] = {}; // < 0 when the counter is unavailable
+};
+//---------------------------------------------------------------------------//
+struct BenchSettings
+{
+  double minTimeSec = 0.1;
+  int repetitions = 3;
+  std::string filter;
+};
+//---------------------------------------------------------------------------//
+static BenchSettings g_Settings;
+static std::vector<BenchResult> g_Results;
+
+// keeps results of pure functions alive:
+static volatile float g_Sink;
+
+//---------------------------------------------------------------------------//
+// Hardware counters
+//---------------------------------------------------------------------------//
+// File descriptors of the opened perf events, -1 when unavailable (no pmu in
+// a vm, perf_event_paranoid, other platforms). Only this process in user mode
+// is counted.
+static int g_CounterFds[CounterCount] = { -1, -1, -1 };
+//---------------------------------------------------------------------------//
+static void
+openCounters()
+{
+#if defined(__linux__)
+  auto cacheEvent = [](uint64_t p_Cache) {
+    return p_Cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  };
+  const uint32_t types[CounterCount] = { PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+  const uint64_t configs[CounterCount] = {
+    cacheEvent(PERF_COUNT_HW_CACHE_L1D), PERF_COUNT_HW_CACHE_MISSES, cacheEvent(PERF_COUNT_HW_CACHE_DTLB) };
+
+  for (int i = 0; i < CounterCount; ++i)
+  {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    g_CounterFds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (g_CounterFds[i] < 0)
+      fprintf(stderr, "hardware counter %s unavailable\n", ms_CounterNames[i]);
+  }
+#endif
+}
+//---------------------------------------------------------------------------//
+static void
+startCounters()
+{
+#if defined(__linux__)
+  for (int fd : g_CounterFds)
+  {
+    if (fd < 0) continue;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+//---------------------------------------------------------------------------//
+static void
+stopCounters(double p_Ops, double p_PerOp[CounterCount])
+{
+  for (int i = 0; i < CounterCount; ++i)
+  {
+    p_PerOp[i] = -1.0;
+#if defined(__linux__)
+    uint64_t value = 0;
+    if (g_CounterFds[i] < 0)
+      continue;
+    ioctl(g_CounterFds[i], PERF_EVENT_IOC_DISABLE, 0);
+    if (sizeof(value) == read(g_CounterFds[i], &value, sizeof(value)))
+      p_PerOp[i] = (double)value / p_Ops;
+#endif
+  }
+}
+
+//---------------------------------------------------------------------------//
+static double
+nowSec()
+{
+  using Clock = std::chrono::steady_clock;
+  return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
+//---------------------------------------------------------------------------//
+static bool
+isFilteredOut(const std::string& p_Name)
+{
+  return !g_Settings.filter.empty() && std::string::npos == p_Name.find(g_Settings.filter);
+}
+//---------------------------------------------------------------------------//
+// Runs p_Fn(iteration) in growing batches until a batch takes at least
+// minTimeSec, then keeps the fastest of a few such batches
+template <typename Fn> static void
+runBench(const std::string& p_Name, double p_PixelsPerOp, double p_TrianglesPerOp, Fn&& p_Fn)
+{
+  if (isFilteredOut(p_Name))
+    return;
+
+  uint64_t counter = 0;
+  uint64_t batch = 1;
+  double elapsed = 0.0;
+  for (;;)
+  {
+    double start = nowSec();
+    for (uint64_t i = 0; i < batch; ++i)
+      p_Fn(counter++);
+    elapsed = nowSec() - start;
+    if (elapsed >= g_Settings.minTimeSec)
+      break;
+    batch = elapsed > 0.0
+      ? std::max(batch * 2, (uint64_t)(batch * 1.2 * g_Settings.minTimeSec / elapsed))
+      : batch * 10;
+  }
+
+  // the calibration batch counts as the first repetition, without counters:
+  BenchResult result;
+  double best = elapsed / batch;
+  for (int i = 0; i < CounterCount; ++i)
+    result.countersPerOp[i] = -1.0;
+  for (int r = 1; r < std::max(2, g_Settings.repetitions); ++r)
+  {
+    double counters[CounterCount];
+    startCounters();
+    double start = nowSec();
+    for (uint64_t i = 0; i < batch; ++i)
+      p_Fn(counter++);
+    const double seconds = (nowSec() - start) / batch;
+    stopCounters((double)batch, counters);
+
+    // counters of the fastest counted batch:
+    if (r == 1 || seconds <= best)
+      std::copy(counters, counters + CounterCount, result.countersPerOp);
+    best = std::min(best, seconds);
+  }
+
+  result.name = p_Name;
+  result.iterations = batch;
+  result.nsPerOp = best * 1e9;
+  result.pixelsPerOp = p_PixelsPerOp;
+  result.trianglesPerOp = p_TrianglesPerOp;
+  g_Results.push_back(result);
+
+  fprintf(stderr, "%-48s %14.1f ns/op", p_Name.c_str(), result.nsPerOp);
+  for (int i = 0; i < CounterCount; ++i)
+    if (result.countersPerOp[i] >= 0.0)
+      fprintf(stderr, " %12.1f %s/op", result.countersPerOp[i], ms_CounterNames[i]);
+  fprintf(stderr, "\n");
+}
+
+//---------------------------------------------------------------------------//
+// Test framebuffer
+//---------------------------------------------------------------------------//
+struct BenchTarget
+{
+  std::vector<uint32_t> colorMemory;
+  std::vector<float> depthMemory;
+  Framebuffer fb;
+
+  BenchTarget(int p_Width, int p_Height)
+    : colorMemory((size_t)p_Width * p_Height, BLACK)
+    , depthMemory((size_t)p_Width * p_Height, 0.0f)
+  {
+    fb.width = p_Width;
+    fb.height = p_Height;
+    fb.color = colorMemory.data();
+    fb.depth = depthMemory.data();
+    clearDepthBuffer(fb);
+  }
+};
+//---------------------------------------------------------------------------//
+struct Resolution
+{
+  const char* name;
+  int width;
+  int height;
+};
+static constexpr Resolution ms_Resolutions[] = {
+  { "512x512", 512, 512 },
+  { "1080p", 1920, 1080 },
+  { "4K", 3840, 2160 },
+  { "8K", 7680, 4320 },
+};
+
+//---------------------------------------------------------------------------//
+// Benchmarks
+//---------------------------------------------------------------------------//
+static void
+benchColorPixel()
+{
+  for (const Resolution& res : ms_Resolutions)
+  {
+    BenchTarget target(res.width, res.height);
+
+    // scattered writes, a cheap lcg keeps the access pattern unpredictable:
+    runBench(std::string("colorPixel/") + res.name, 1.0, 0.0, [&](uint64_t p_I) {
+      uint32_t h = (uint32_t)p_I * 2654435761u;
+      colorPixel(target.fb, (int)(h % (uint32_t)res.width), (int)((h >> 7) % (uint32_t)res.height), WHITE);
+    });
+  }
+}
+//---------------------------------------------------------------------------//
+static void
+benchClearBuffer()
+{
+  for (const Resolution& res : ms_Resolutions)
+  {
+    BenchTarget target(res.width, res.height);
+    runBench(std::string("clearBuffer/") + res.name, (double)res.width * res.height, 0.0, [&](uint64_t) {
+      clearBuffer(target.fb, BLACK);
+    });
+  }
+}
+//---------------------------------------------------------------------------//
+static void
+benchDrawLine()
+{
+  struct Slope { const char* name; int dx; int dy; };
+  static constexpr Slope slopes[] = {
+    { "horizontal", 1000, 0 },
+    { "shallow", 1000, 300 },
+    { "diagonal", 1000, 1000 },
+    { "steep", 300, 1000 },
+    { "vertical", 0, 1000 },
+  };
+
+  BenchTarget target(1024, 1024);
+  for (const Slope& slope : slopes)
+  {
+    const double pixels = (double)std::max(slope.dx, slope.dy) + 1.0;
+    runBench(std::string("drawLineSimple/") + slope.name, pixels, 0.0, [&](uint64_t p_I) {
+      int offset = (int)(p_I & 15);
+      drawLineSimple(target.fb, 10 + offset, 10, 10 + offset + slope.dx, 10 + slope.dy, WHITE);
+    });
+  }
+}
+//---------------------------------------------------------------------------//
+static void
+benchBarycentric()
+{
+  const Vec3F triangle[3] = { Vec3F(10, 10, 0), Vec3F(500, 40, 0), Vec3F(200, 480, 0) };
+  runBench("barycentric", 1.0, 0.0, [&](uint64_t p_I) {
+    Vec3F point((float)(p_I & 511), (float)((p_I >> 9) & 511), 0.0f);
+    g_Sink = barycentric(triangle, point).x;
+  });
+}
+//---------------------------------------------------------------------------//
+static int
+countCovered(const Framebuffer& p_Fb, uint32_t p_Color)
+{
+  int count = 0;
+  for (int i = 0; i < p_Fb.width * p_Fb.height; ++i)
+    count += p_Color == p_Fb.color[i];
+  return count;
+}
+//---------------------------------------------------------------------------//
+static void
+benchDrawTriangle()
+{
+  static constexpr int sizes[] = { 4, 16, 64, 256, 1024 };
+
+  BenchTarget target(2048, 2048);
+  for (int size : sizes)
+  {
+    // right-ish triangle with both legs of length size:
+    const float s = (float)size;
+    Vec3F triangle[3] = { Vec3F(8, 8, 0), Vec3F(8 + s, 8 + s * 0.25f, 0), Vec3F(8 + s * 0.25f, 8 + s, 0) };
+
+    clearBuffer(target.fb, BLACK);
+    drawTriangle(target.fb, triangle, WHITE, false);
+    const double pixels = (double)countCovered(target.fb, WHITE);
+
+    for (int depthTest = 0; depthTest < 2; ++depthTest)
+    {
+      clearDepthBuffer(target.fb);
+      std::string name = "drawTriangle/" + std::to_string(size) + (depthTest ? "/depth" : "/nodepth");
+      runBench(name, pixels, 1.0, [&](uint64_t p_I) {
+        // move the triangle towards the viewer so every depth test passes,
+        // restart before z runs out of float precision:
+        const uint64_t step = p_I & 0xFFFFF;
+        if (depthTest && 0 == step)
+          clearDepthBuffer(target.fb);
+        Vec3F moved[3] = { triangle[0], triangle[1], triangle[2] };
+        moved[0].z = moved[1].z = moved[2].z = (float)step;
+        drawTriangle(target.fb, moved, WHITE, 0 != depthTest);
+      });
+    }
+  }
+}
+//---------------------------------------------------------------------------//
+// Every traversal on the same shapes at 4K, where a 15 KB row stride costs a
+// cache line and a tlb entry per step of the column walk
+static void
+benchTraversal()
+{
+  struct Shape { const char* name; Vec3F vertices[3]; };
+  static const Shape shapes[] = {
+    { "large", { Vec3F(100, 100, 0), Vec3F(1700, 300, 0), Vec3F(500, 1900, 0) } },
+    { "wide", { Vec3F(100, 1000, 0), Vec3F(3700, 1040, 0), Vec3F(1500, 1100, 0) } },
+    { "tall", { Vec3F(1000, 60, 0), Vec3F(1060, 1500, 0), Vec3F(1010, 2100, 0) } },
+    { "sliver", { Vec3F(100, 100, 0), Vec3F(2100, 2000, 0), Vec3F(2120, 2040, 0) } },
+  };
+  static constexpr RasterTraversal traversals[] = {
+    RasterTraversal::Rows, RasterTraversal::Tiles, RasterTraversal::Columns };
+
+  const RasterTraversal previous = getRasterTraversal();
+  BenchTarget target(3840, 2160);
+  for (const Shape& shape : shapes)
+  {
+    clearBuffer(target.fb, BLACK);
+    setRasterTraversal(RasterTraversal::Rows);
+    drawTriangle(target.fb, shape.vertices, WHITE, false);
+    const double pixels = (double)countCovered(target.fb, WHITE);
+
+    for (RasterTraversal traversal : traversals)
+    {
+      setRasterTraversal(traversal);
+      clearDepthBuffer(target.fb);
+      std::string name = std::string("traversal/") + shape.name + "/" + getRasterTraversalName(traversal);
+      runBench(name, pixels, 1.0, [&](uint64_t p_I) {
+        const uint64_t step = p_I & 0xFFFFF;
+        if (0 == step)
+          clearDepthBuffer(target.fb);
+        Vec3F moved[3] = { shape.vertices[0], shape.vertices[1], shape.vertices[2] };
+        moved[0].z = moved[1].z = moved[2].z = (float)step;
+        drawTriangle(target.fb, moved, WHITE, true);
+      });
+    }
+  }
+  setRasterTraversal(previous);
+}
+//---------------------------------------------------------------------------//
+static void
+benchDrawModel()
+{
+  static constexpr Resolution resolutions[] = { { "512x512", 512, 512 }, { "4K", 3840, 2160 } };
+  static const std::string prefix = "drawModelDepth/african_head/";
+
+  // don't pay for loading the model when every case is filtered out:
+  if (isFilteredOut(prefix + resolutions[0].name) && isFilteredOut(prefix + resolutions[1].name))
+    return;
+
+  Model model(RASTER_ASSETS_DIR "/obj/african_head/african_head.obj");
+  if (!model.initialized)
+  {
+    fprintf(stderr, "can't load african_head, skipping model benchmarks\n");
+    return;
+  }
+
+  for (const Resolution& res : resolutions)
+  {
+    BenchTarget target(res.width, res.height);
+    target.fb.flipVertically = true;
+    runBench(prefix + res.name, (double)res.width * res.height,
+      (double)model.nfaces(), [&](uint64_t) {
+        clearBuffer(target.fb, BLACK);
+        clearDepthBuffer(target.fb);
+        drawModelDepth(target.fb, model, Camera());
+      });
+  }
+}
+
+//---------------------------------------------------------------------------//
+// Tile-binned drawModelDepth at 4K on 1, 2, 4, ... threads up to one per core
+static void
+benchThreads()
+{
+  static const std::string prefix = "threads/african_head/4K/";
+
+  const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<uint32_t> threadCounts;
+  for (uint32_t threads = 1; threads < cores; threads *= 2)
+    if (!isFilteredOut(prefix + std::to_string(threads)))
+      threadCounts.push_back(threads);
+  if (!isFilteredOut(prefix + std::to_string(cores)))
+    threadCounts.push_back(cores);
+  if (threadCounts.empty())
+    return;
+
+  Model model(RASTER_ASSETS_DIR "/obj/african_head/african_head.obj");
+  if (!model.initialized)
+  {
+    fprintf(stderr, "can't load african_head, skipping thread benchmarks\n");
+    return;
+  }
+
+  const uint32_t previous = JobSystem::getThreadCount();
+  BenchTarget target(3840, 2160);
+  target.fb.flipVertically = true;
+  for (uint32_t threads : threadCounts)
+  {
+    JobSystem::setThreadCount(threads);
+    runBench(prefix + std::to_string(threads), (double)target.fb.width * target.fb.height,
+      (double)model.nfaces(), [&](uint64_t) {
+        clearBuffer(target.fb, BLACK);
+        clearDepthBuffer(target.fb);
+        drawModelDepth(target.fb, model, Camera());
+      });
+  }
+  JobSystem::setThreadCount(previous);
+}
+
+//---------------------------------------------------------------------------//
+// Json output and baseline comparison
+//---------------------------------------------------------------------------//
+static bool
+writeJson(const char* p_Path)
+{
+  FILE* file = (0 == strcmp(p_Path, "-")) ? stdout : fopen(p_Path, "w");
+  if (nullptr == file)
+  {
+    fprintf(stderr, "can't open file %s\n", p_Path);
+    return false;
+  }
+
+  // one benchmark per line, readBaseline relies on it
+  fprintf(file, "{\n  \"isa\": \"%s\",\n  \"traversal\": \"%s\",\n  \"threads\": %u,\n  \"benchmarks\": [\n",
+    getRasterIsaName(getRasterIsa()), getRasterTraversalName(getRasterTraversal()), JobSystem::getThreadCount());
+  for (size_t i = 0; i < g_Results.size(); ++i)
+  {
+    const BenchResult& r = g_Results[i];
+    const double opsPerSec = 1e9 / r.nsPerOp;
+    fprintf(file,
+      "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"pixels_per_s\": %.1f, \"triangles_per_s\": %.1f",
+      r.name.c_str(), (unsigned long long)r.iterations, r.nsPerOp,
+      r.pixelsPerOp * opsPerSec, r.trianglesPerOp * opsPerSec);
+    for (int c = 0; c < CounterCount; ++c)
+      if (r.countersPerOp[c] >= 0.0)
+        fprintf(file, ", \"%s_per_op\": %.2f", ms_CounterNames[c], r.countersPerOp[c]);
+    fprintf(file, "}%s\n", (i + 1 < g_Results.size()) ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+
+  if (stdout != file)
+    fclose(file);
+  return true;
+}
+//---------------------------------------------------------------------------//
+static bool
+readBaseline(const char* p_Path, std::vector<BenchResult>& p_Baseline)
+{
+  FILE* file = fopen(p_Path, "r");
+  if (nullptr == file)
+  {
+    fprintf(stderr, "can't open baseline %s\n", p_Path);
+    return false;
+  }
+
+  char line[1024];
+  while (fgets(line, sizeof(line), file))
+  {
+    char name[256];
+    double nsPerOp = 0.0;
+    const char* entry = strstr(line, "{\"name\": \"");
+    if (nullptr == entry)
+      continue;
+    if (2 == sscanf(entry, "{\"name\": \"%255[^\"]\", \"iterations\": %*u, \"ns_per_op\": %lf", name, &nsPerOp))
+    {
+      BenchResult r;
+      r.name = name;
+      r.nsPerOp = nsPerOp;
+      p_Baseline.push_back(r);
+    }
+  }
+
+  fclose(file);
+  return true;
+}
+//---------------------------------------------------------------------------//
+// Returns the number of benchmarks slower than baseline by more than
+// p_MaxRegression, -1 when no benchmark of this run has a usable baseline
+// (renamed, filtered out or an empty file) so the gate can't pass unchecked
+static int
+compareBaseline(const std::vector<BenchResult>& p_Baseline, double p_MaxRegression)
+{
+  int regressions = 0;
+  int compared = 0;
+  for (const BenchResult& current : g_Results)
+  {
+    for (const BenchResult& base : p_Baseline)
+    {
+      if (base.name != current.name)
+        continue;
+      if (!(base.nsPerOp > 0.0))
+      {
+        fprintf(stderr, "%-48s skipped, baseline ns_per_op is %g\n", current.name.c_str(), base.nsPerOp);
+        continue;
+      }
+
+      ++compared;
+      const double ratio = current.nsPerOp / base.nsPerOp;
+      const bool regressed = ratio > 1.0 + p_MaxRegression;
+      regressions += regressed;
+      fprintf(stderr, "%-48s %6.2fx %s\n", current.name.c_str(), 1.0 / ratio, regressed ? "REGRESSION" : "");
+    }
+  }
+  if (0 == compared)
+  {
+    fprintf(stderr, "no benchmark of this run has a baseline in the file\n");
+    return -1;
+  }
+  return regressions;
+}
+
+//---------------------------------------------------------------------------//
+// Main function
+//---------------------------------------------------------------------------//
+static void
+printUsage(const char* p_Exe)
+{
+  fprintf(stderr,
+    "usage: %s [options]\n"
+    "  -o <file>                 json output, - for stdout (default raster_bench.json)\n"
+    "  --filter <substring>      only run benchmarks whose name contains substring\n"
+    "  --min-time <seconds>      minimum time per measured batch (default 0.1)\n"
+    "  --repetitions <n>         measured batches per benchmark, fastest wins (default 3)\n"
+    "  --baseline <file>         compare against a previous json output\n"
+    "  --max-regression <ratio>  allowed slowdown vs baseline before failing (default 0.10)\n"
+    "  --isa <name>              triangle kernels: scalar | sse4.1 | avx2 | avx512 (default: best the cpu has)\n"
+    "  --traversal <name>        block order: rows | tiles | columns (default rows)\n"
+    "  --threads <n>             raster threads of the model benchmarks (default: one per core)\n",
+    p_Exe);
+}
+//---------------------------------------------------------------------------//
+int
+main(int p_Argc, char** p_Argv)
+{
+  const char* output = "raster_bench.json";
+  const char* baselinePath = nullptr;
+  double maxRegression = 0.10;
+
+  for (int i = 1; i < p_Argc; ++i)
+  {
+    const char* arg = p_Argv[i];
+    const bool hasValue = i + 1 < p_Argc;
+
+    if (0 == strcmp(arg, "-o") && hasValue)
+      output = p_Argv[++i];
+    else if (0 == strcmp(arg, "--filter") && hasValue)
+      g_Settings.filter = p_Argv[++i];
+    else if (0 == strcmp(arg, "--min-time") && hasValue)
+      g_Settings.minTimeSec = atof(p_Argv[++i]);
+    else if (0 == strcmp(arg, "--repetitions") && hasValue)
+      g_Settings.repetitions = std::max(1, atoi(p_Argv[++i]));
+    else if (0 == strcmp(arg, "--baseline") && hasValue)
+      baselinePath = p_Argv[++i];
+    else if (0 == strcmp(arg, "--max-regression") && hasValue)
+      maxRegression = atof(p_Argv[++i]);
+    else if (0 == strcmp(arg, "--isa") && hasValue)
+    {
+      RasterIsa isa;
+      if (!parseRasterIsa(p_Argv[++i], isa) || !setRasterIsa(isa))
+      {
+        fprintf(stderr, "unknown or unsupported isa %s\n", p_Argv[i]);
+        return 1;
+      }
+    }
+    else if (0 == strcmp(arg, "--traversal") && hasValue)
+    {
+      RasterTraversal traversal;
+      if (!parseRasterTraversal(p_Argv[++i], traversal))
+      {
+        fprintf(stderr, "unknown traversal %s\n", p_Argv[i]);
+        return 1;
+      }
+      setRasterTraversal(traversal);
+    }
+    else if (0 == strcmp(arg, "--threads") && hasValue)
+      JobSystem::setThreadCount((uint32_t)std::max(1, atoi(p_Argv[++i])));
+    else
+    {
+      printUsage(p_Argv[0]);
+      return 1;
+    }
+  }
+
+  fprintf(stderr, "triangle kernels: %s, traversal: %s, threads: %u\n",
+    getRasterIsaName(getRasterIsa()), getRasterTraversalName(getRasterTraversal()), JobSystem::getThreadCount());
+  openCounters();
+  benchColorPixel();
+  benchClearBuffer();
+  benchDrawLine();
+  benchBarycentric();
+  benchDrawTriangle();
+  benchTraversal();
+  benchDrawModel();
+  benchThreads();
+
+  if (!writeJson(output))
+    return 1;
+
+  if (nullptr != baselinePath)
+  {
+    std::vector<BenchResult> baseline;
+    if (!readBaseline(baselinePath, baseline))
+      return 1;
+    const int regressions = compareBaseline(baseline, maxRegression);
+    if (regressions < 0)
+      return 1;
+    if (regressions > 0)
+      return 2;
+  }
+
+  return 0;
+}
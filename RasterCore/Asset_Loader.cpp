@@ -0,0 +1,219 @@
+// Asset_Loader.cpp : background mesh and texture loading.
+//
+
+#include "Asset_Loader.hpp"
+#include "Job_System.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
+
+#include <tinyrenderer/model.h>
+#include <tinyrenderer/tgaimage.h>
+
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+//---------------------------------------------------------------------------//
+// Loader state
+//---------------------------------------------------------------------------//
+// A couple of threads keep a disk busy and overlap one load's parsing with
+// the next one's reads, more mostly contend for the same disk
+static constexpr uint32_t ms_DefaultLoaderThreads = 2;
+//---------------------------------------------------------------------------//
+struct LoaderState
+{
+  std::mutex configMutex;
+  std::vector<std::thread> threads;
+
+  std::mutex queueMutex;
+  std::condition_variable wake; // a load was queued or quit was set
+  std::condition_variable idle; // busy dropped to zero
+  std::deque<std::function<void()>> queue;
+  uint32_t busy = 0; // queued plus running
+  bool quit = false;
+
+  LoaderState();
+  ~LoaderState() { stop(); }
+
+  void start(uint32_t p_ThreadCount);
+  void stop();
+  void threadMain();
+};
+//---------------------------------------------------------------------------//
+// Created on the first request, after the job system: statics are destroyed
+// in reverse order, so the loader threads (whose obj parsing runs jobs) are
+// joined while the job system is still up.
+static LoaderState&
+getLoader()
+{
+  static LoaderState s_Loader;
+  return s_Loader;
+}
+
+//---------------------------------------------------------------------------//
+LoaderState::LoaderState()
+{
+  // initializes Job_System.cpp's state before this one's constructor ends
+  JobSystem::getThreadCount();
+}
+//---------------------------------------------------------------------------//
+void
+LoaderState::start(uint32_t p_ThreadCount)
+{
+  if (0 == p_ThreadCount)
+    p_ThreadCount = ms_DefaultLoaderThreads;
+  quit = false;
+  for (uint32_t i = 0; i < p_ThreadCount; ++i)
+    threads.emplace_back(&LoaderState::threadMain, this);
+}
+//---------------------------------------------------------------------------//
+void
+LoaderState::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    quit = true;
+  }
+  wake.notify_all();
+  for (std::thread& thread : threads)
+    thread.join();
+  threads.clear();
+  queue.clear();
+  busy = 0;
+}
+//---------------------------------------------------------------------------//
+// Quit drops the loads still queued, only the program exit sets it with loads
+// pending (setThreadCount waits for them)
+void
+LoaderState::threadMain()
+{
+  for (;;)
+  {
+    std::function<void()> load;
+    {
+      std::unique_lock<std::mutex> lock(queueMutex);
+      wake.wait(lock, [this] { return quit || !queue.empty(); });
+      if (quit)
+        return;
+      load = std::move(queue.front());
+      queue.pop_front();
+    }
+
+    load();
+
+    {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      if (0 == --busy)
+        idle.notify_all();
+    }
+  }
+}
+//---------------------------------------------------------------------------//
+static void
+queueLoad(std::function<void()> p_Load)
+{
+  LoaderState& loader = getLoader();
+  {
+    std::lock_guard<std::mutex> lock(loader.configMutex);
+    if (loader.threads.empty())
+      loader.start(0);
+  }
+  {
+    std::lock_guard<std::mutex> lock(loader.queueMutex);
+    loader.queue.push_back(std::move(p_Load));
+    ++loader.busy;
+  }
+  loader.wake.notify_one();
+}
+//---------------------------------------------------------------------------//
+template <typename T>
+static void
+finishLoad(AssetSlot<T>& p_Slot, std::unique_ptr<T> p_Asset)
+{
+  {
+    std::lock_guard<std::mutex> lock(p_Slot.mutex);
+    p_Slot.asset = std::move(p_Asset);
+    p_Slot.state = p_Slot.asset ? AssetState::Ready : AssetState::Failed;
+  }
+  p_Slot.done.notify_all();
+}
+
+//---------------------------------------------------------------------------//
+// AssetLoader
+//---------------------------------------------------------------------------//
+AssetHandle<Model>
+AssetLoader::loadModel(const std::string& p_Path, bool p_UseCache, bool p_VerifyCache)
+{
+  auto slot = std::make_shared<AssetSlot<Model>>();
+  slot->path = p_Path;
+  queueLoad([slot, p_UseCache, p_VerifyCache] {
+    RASTER_PROFILE_ZONE("load model");
+    auto model = std::make_unique<Model>(slot->path.c_str(), p_UseCache, p_VerifyCache, JobSystem::parallelRanges);
+    if (!model->initialized)
+      model.reset();
+    finishLoad(*slot, std::move(model));
+  });
+  return AssetHandle<Model>(slot);
+}
+//---------------------------------------------------------------------------//
+AssetHandle<TGAImage>
+AssetLoader::loadImage(const std::string& p_Path)
+{
+  auto slot = std::make_shared<AssetSlot<TGAImage>>();
+  slot->path = p_Path;
+  queueLoad([slot] {
+    RASTER_PROFILE_ZONE("load image");
+    auto image = std::make_unique<TGAImage>();
+    if (!image->read_tga_file(slot->path))
+      image.reset();
+    finishLoad(*slot, std::move(image));
+  });
+  return AssetHandle<TGAImage>(slot);
+}
+//---------------------------------------------------------------------------//
+AssetHandle<Texture>
+AssetLoader::loadTexture(const std::string& p_Path)
+{
+  auto slot = std::make_shared<AssetSlot<Texture>>();
+  slot->path = p_Path;
+  queueLoad([slot] {
+    RASTER_PROFILE_ZONE("load texture");
+    std::unique_ptr<Texture> texture;
+    TGAImage image;
+    if (image.read_tga_file(slot->path))
+    {
+      texture = std::make_unique<Texture>(image);
+      if (!texture->isValid())
+        texture.reset();
+    }
+    finishLoad(*slot, std::move(texture));
+  });
+  return AssetHandle<Texture>(slot);
+}
+//---------------------------------------------------------------------------//
+void
+AssetLoader::waitIdle()
+{
+  LoaderState& loader = getLoader();
+  std::unique_lock<std::mutex> lock(loader.queueMutex);
+  loader.idle.wait(lock, [&] { return 0 == loader.busy; });
+}
+//---------------------------------------------------------------------------//
+void
+AssetLoader::setThreadCount(uint32_t p_Count)
+{
+  waitIdle();
+  LoaderState& loader = getLoader();
+  std::lock_guard<std::mutex> lock(loader.configMutex);
+  loader.stop();
+  loader.start(p_Count);
+}
+//---------------------------------------------------------------------------//
+uint32_t
+AssetLoader::getThreadCount()
+{
+  LoaderState& loader = getLoader();
+  std::lock_guard<std::mutex> lock(loader.configMutex);
+  return loader.threads.empty() ? ms_DefaultLoaderThreads : (uint32_t)loader.threads.size();
+}
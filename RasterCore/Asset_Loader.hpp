@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class Model;
+class Texture;
+struct TGAImage;
+
+//---------------------------------------------------------------------------//
+enum class AssetState : uint32_t
+{
+  Loading,
+  Ready,
+  Failed
+};
+//---------------------------------------------------------------------------//
+// Shared between the loader thread and every copy of the handle
+template <typename T>
+struct AssetSlot
+{
+  std::atomic<AssetState> state = AssetState::Loading;
+  std::unique_ptr<T> asset; // set before state turns Ready
+  std::string path;
+
+  std::mutex mutex;
+  std::condition_variable done;
+};
+//---------------------------------------------------------------------------//
+// Result of an asynchronous load. Copies share the asset, which lives as long
+// as the last copy. Polling it is a single atomic load, so a renderer can ask
+// every frame and draw a placeholder or nothing until the asset is ready.
+//---------------------------------------------------------------------------//
+template <typename T>
+class AssetHandle
+{
+public:
+  AssetHandle() = default;
+  explicit AssetHandle(std::shared_ptr<AssetSlot<T>> p_Slot) : m_Slot(std::move(p_Slot)) {}
+
+  bool isValid() const { return nullptr != m_Slot; }
+  AssetState getState() const { return m_Slot ? m_Slot->state.load() : AssetState::Failed; }
+  bool isReady() const { return AssetState::Ready == getState(); }
+  const std::string& getPath() const { return m_Slot->path; }
+
+  // nullptr until the asset is ready
+  const T* get() const { return isReady() ? m_Slot->asset.get() : nullptr; }
+
+  // Blocks until the load finished, nullptr when it failed (the loader does
+  // not report failures, the caller knows what to do about them)
+  const T* wait() const
+  {
+    if (!m_Slot)
+      return nullptr;
+    std::unique_lock<std::mutex> lock(m_Slot->mutex);
+    m_Slot->done.wait(lock, [this] { return AssetState::Loading != m_Slot->state.load(); });
+    return get();
+  }
+
+private:
+  std::shared_ptr<AssetSlot<T>> m_Slot;
+};
+
+//---------------------------------------------------------------------------//
+// Loads meshes and textures on a small pool of background threads, apart from
+// the job system: loads spend much of their time blocked on the disk and
+// would stall the raster jobs queued behind them. Decoding that splits into
+// jobs itself (large obj files) still uses the job system.
+//
+// Loads run in the order they were requested, as many at a time as there
+// are loader threads.
+//---------------------------------------------------------------------------//
+struct AssetLoader
+{
+  //---------------------------------------------------------------------------//
+  // Model(p_Path, p_UseCache, p_VerifyCache) on a loader thread
+  static AssetHandle<Model>
+  loadModel(const std::string& p_Path, bool p_UseCache = true, bool p_VerifyCache = false);
+  //---------------------------------------------------------------------------//
+  // TGAImage::read_tga_file on a loader thread
+  static AssetHandle<TGAImage>
+  loadImage(const std::string& p_Path);
+  //---------------------------------------------------------------------------//
+  // loadImage converted to a tiled Texture on the loader thread, the image is
+  // freed right after
+  static AssetHandle<Texture>
+  loadTexture(const std::string& p_Path);
+  //---------------------------------------------------------------------------//
+  // Blocks until every requested load finished
+  static void
+  waitIdle();
+  //---------------------------------------------------------------------------//
+  // 0 picks the default (2). Waits for the pending loads first.
+  static void
+  setThreadCount(uint32_t p_Count);
+  //---------------------------------------------------------------------------//
+  static uint32_t
+  getThreadCount();
+};
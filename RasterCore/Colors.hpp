@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Math_Types.hpp"
+
+//---------------------------------------------------------------------------//
+// Constants
+//---------------------------------------------------------------------------//
+
+// Uint32 colors can be used directly
+constexpr uint32_t WHITE =
+  (255u << 24) |  // alpha
+  (255 << 16) |   // blue
+  (255 << 8)  |   // green
+  (255 << 0);     // red
+
+constexpr uint32_t BLACK =
+  (255u << 24) |  // alpha
+  (0 << 16)   |   // blue
+  (0 << 8)    |   // green
+  (0 << 0);       // red
+
+constexpr uint32_t BLUE =
+  (255u << 24) |  // alpha
+  (255 << 16) |   // blue
+  (0 << 8)    |   // green
+  (0 << 0);       // red
+
+constexpr uint32_t RED =
+  (255u << 24) |  // alpha
+  (0 << 16)   |   // blue
+  (0 << 8)    |   // green
+  (255 << 0);     // red
+
+//---------------------------------------------------------------------------//
+// Float color values should be converted to Uint32 before using
+namespace Colors
+{
+struct ColorRGBA
+{
+  float r;
+  float g;
+  float b;
+  float a;
+
+  uint32_t convertToUint32 () const
+  {
+    uint32_t color32 =
+        (((uint32_t)roundFloatToUInt(a * 255.0f) << 24) |
+        ((uint32_t)roundFloatToUInt(b * 255.0f) << 16) |
+        ((uint32_t)roundFloatToUInt(g * 255.0f) << 8) |
+        ((uint32_t)roundFloatToUInt(r * 255.0f) << 0));
+
+    return color32;
+  }
+
+  ColorRGBA operator *(float p_Scalar)     const
+  {
+    return { r * p_Scalar, g * p_Scalar, b * p_Scalar, a};
+  }
+};
+static constexpr ColorRGBA White = { 1.0f, 1.0f, 1.0f, 1.0f };
+static constexpr ColorRGBA Black = { 0.0f, 0.0f, 0.0f, 1.0f };
+static constexpr ColorRGBA Red = { 1.0f, 0.0f, 0.0f, 1.0f };
+static constexpr ColorRGBA Blue = { 0.0f, 0.0f, 1.0f, 1.0f };
+}
@@ -0,0 +1,366 @@
+// Job_System.cpp : work-stealing job system.
+//
+
+#include "Job_System.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+//---------------------------------------------------------------------------//
+// Job system state
+//---------------------------------------------------------------------------//
+// The deques are guarded by a mutex each: owner and thieves contend on one
+// deque at a time and the critical sections are a few pointer moves, so a
+// lock-free deque would not buy much for jobs of tile size.
+struct alignas(64) WorkerDeque
+{
+  std::mutex mutex;
+  std::deque<QueuedJob> jobs;
+};
+//---------------------------------------------------------------------------//
+static constexpr uint32_t ms_NoWorker = UINT32_MAX;
+
+// Slots for threads outside the pool (the front-end's main thread, the asset
+// loader threads) that submit or wait at the same time. More callers than
+// this wait for a slot to free up.
+static constexpr uint32_t ms_CallerSlots = 8;
+
+// Worker slots:
+//   [0, poolThreads)                   the pool threads
+//   [poolThreads, injectSlot)          threads outside the pool while they wait
+//   injectSlot                         owned by nobody, run() from outside
+struct JobState
+{
+  std::mutex configMutex;
+  bool started = false;
+  uint32_t threadCount = 1;
+  uint32_t poolThreads = 0;
+  uint32_t injectSlot = 0;
+  std::vector<std::unique_ptr<WorkerDeque>> deques; // one per slot
+  std::vector<std::thread> threads;
+
+  // free caller slots, only touched to take or return one
+  std::mutex callerMutex;
+  std::condition_variable callerFree;
+  std::vector<uint32_t> freeCallerSlots;
+
+  // idle workers sleep until a job is queued, waiters until a counter
+  // reaches zero:
+  std::mutex sleepMutex;
+  std::condition_variable sleep;
+  std::atomic<uint32_t> queued = 0;
+  bool quit = false;
+
+  ~JobState() { stop(); }
+
+  void start(uint32_t p_ThreadCount);
+  void stop();
+  void workerMain(uint32_t p_Worker);
+};
+//---------------------------------------------------------------------------//
+static JobState g_Jobs;
+static thread_local uint32_t t_WorkerIndex = ms_NoWorker;
+
+//---------------------------------------------------------------------------//
+static void
+ensureStarted()
+{
+  std::lock_guard<std::mutex> lock(g_Jobs.configMutex);
+  if (!g_Jobs.started)
+    g_Jobs.start(0);
+}
+//---------------------------------------------------------------------------//
+// Gives a thread outside the pool a slot of its own for its lifetime, a
+// no-op on pool threads and for nested use. Callers never share a slot, so
+// any number of them submit and wait side by side.
+struct CallerSlot
+{
+  bool m_Outside = ms_NoWorker == t_WorkerIndex;
+
+  CallerSlot()
+  {
+    if (!m_Outside)
+      return;
+    ensureStarted();
+    std::unique_lock<std::mutex> lock(g_Jobs.callerMutex);
+    g_Jobs.callerFree.wait(lock, [] { return !g_Jobs.freeCallerSlots.empty(); });
+    t_WorkerIndex = g_Jobs.freeCallerSlots.back();
+    g_Jobs.freeCallerSlots.pop_back();
+  }
+  ~CallerSlot()
+  {
+    if (!m_Outside)
+      return;
+    {
+      std::lock_guard<std::mutex> lock(g_Jobs.callerMutex);
+      g_Jobs.freeCallerSlots.push_back(t_WorkerIndex);
+    }
+    t_WorkerIndex = ms_NoWorker;
+    g_Jobs.callerFree.notify_one();
+  }
+};
+//---------------------------------------------------------------------------//
+// Deque a job queued by the calling thread goes to
+static uint32_t
+submitSlot()
+{
+  return ms_NoWorker == t_WorkerIndex ? g_Jobs.injectSlot : t_WorkerIndex;
+}
+//---------------------------------------------------------------------------//
+static void
+wakeAll()
+{
+  {
+    std::lock_guard<std::mutex> lock(g_Jobs.sleepMutex);
+  }
+  g_Jobs.sleep.notify_all();
+}
+//---------------------------------------------------------------------------//
+static void
+pushJob(uint32_t p_Worker, QueuedJob&& p_Job)
+{
+  WorkerDeque& deque = *g_Jobs.deques[p_Worker];
+  {
+    std::lock_guard<std::mutex> lock(deque.mutex);
+    deque.jobs.push_back(std::move(p_Job));
+  }
+  g_Jobs.queued.fetch_add(1);
+
+  // taking the sleep mutex orders the push before a sleeper's check:
+  {
+    std::lock_guard<std::mutex> lock(g_Jobs.sleepMutex);
+  }
+  g_Jobs.sleep.notify_one();
+}
+//---------------------------------------------------------------------------//
+// Own deque from the back, then the others from the front
+static bool
+popOrSteal(uint32_t p_Worker, QueuedJob& p_Job)
+{
+  const uint32_t count = (uint32_t)g_Jobs.deques.size();
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const uint32_t victim = (p_Worker + i) % count;
+    WorkerDeque& deque = *g_Jobs.deques[victim];
+    std::lock_guard<std::mutex> lock(deque.mutex);
+    if (deque.jobs.empty())
+      continue;
+
+    if (0 == i)
+    {
+      p_Job = std::move(deque.jobs.back());
+      deque.jobs.pop_back();
+    }
+    else
+    {
+      p_Job = std::move(deque.jobs.front());
+      deque.jobs.pop_front();
+    }
+    g_Jobs.queued.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
+//---------------------------------------------------------------------------//
+static void
+finishJob(JobCounter& p_Counter)
+{
+  // the decrement happens under the counter's mutex, wait() takes it once
+  // more before it returns so the counter outlives this function:
+  std::vector<QueuedJob> continuations;
+  {
+    std::lock_guard<std::mutex> lock(p_Counter.mutex);
+    if (1 != p_Counter.pending.fetch_sub(1))
+      return;
+    continuations.swap(p_Counter.continuations);
+  }
+
+  const uint32_t slot = submitSlot();
+  for (QueuedJob& job : continuations)
+    pushJob(slot, std::move(job));
+  wakeAll();
+}
+//---------------------------------------------------------------------------//
+static void
+executeJob(QueuedJob& p_Job)
+{
+  p_Job.function();
+  p_Job.function = nullptr;
+  finishJob(*p_Job.counter);
+}
+
+//---------------------------------------------------------------------------//
+void
+JobState::start(uint32_t p_ThreadCount)
+{
+  if (0 == p_ThreadCount)
+    p_ThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+  // the thread that waits works along, one pool thread less:
+  threadCount = p_ThreadCount;
+  poolThreads = p_ThreadCount - 1;
+  injectSlot = poolThreads + ms_CallerSlots;
+
+  quit = false;
+  deques.clear();
+  for (uint32_t slot = 0; slot <= injectSlot; ++slot)
+    deques.push_back(std::make_unique<WorkerDeque>());
+  {
+    std::lock_guard<std::mutex> lock(callerMutex);
+    freeCallerSlots.clear();
+    for (uint32_t slot = injectSlot; slot-- > poolThreads;)
+      freeCallerSlots.push_back(slot);
+  }
+  for (uint32_t worker = 0; worker < poolThreads; ++worker)
+    threads.emplace_back(&JobState::workerMain, this, worker);
+  started = true;
+}
+//---------------------------------------------------------------------------//
+void
+JobState::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    quit = true;
+  }
+  sleep.notify_all();
+  for (std::thread& thread : threads)
+    thread.join();
+  threads.clear();
+  started = false;
+}
+//---------------------------------------------------------------------------//
+void
+JobState::workerMain(uint32_t p_Worker)
+{
+  t_WorkerIndex = p_Worker;
+  for (;;)
+  {
+    QueuedJob job;
+    if (popOrSteal(p_Worker, job))
+    {
+      executeJob(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleep.wait(lock, [this] { return quit || queued.load() > 0; });
+    if (quit && 0 == queued.load())
+      return;
+  }
+}
+
+//---------------------------------------------------------------------------//
+// JobSystem
+//---------------------------------------------------------------------------//
+void
+JobSystem::run(JobCounter& p_Counter, Job p_Job)
+{
+  ensureStarted();
+  p_Counter.pending.fetch_add(1);
+  pushJob(submitSlot(), QueuedJob{ std::move(p_Job), &p_Counter });
+}
+//---------------------------------------------------------------------------//
+void
+JobSystem::runAfter(JobCounter& p_Dependency, JobCounter& p_Counter, Job p_Job)
+{
+  ensureStarted();
+  p_Counter.pending.fetch_add(1);
+  {
+    // finishJob empties the list after pending hit zero, under this lock:
+    std::lock_guard<std::mutex> lock(p_Dependency.mutex);
+    if (0 != p_Dependency.pending.load())
+    {
+      p_Dependency.continuations.push_back(QueuedJob{ std::move(p_Job), &p_Counter });
+      return;
+    }
+  }
+  pushJob(submitSlot(), QueuedJob{ std::move(p_Job), &p_Counter });
+}
+//---------------------------------------------------------------------------//
+void
+JobSystem::wait(JobCounter& p_Counter)
+{
+  CallerSlot slot;
+  while (0 != p_Counter.pending.load())
+  {
+    QueuedJob job;
+    if (popOrSteal(t_WorkerIndex, job))
+    {
+      executeJob(job);
+      continue;
+    }
+
+    // the rest runs on other threads:
+    std::unique_lock<std::mutex> lock(g_Jobs.sleepMutex);
+    g_Jobs.sleep.wait(lock, [&] { return 0 == p_Counter.pending.load() || g_Jobs.queued.load() > 0; });
+  }
+
+  // the last finishJob may still hold the mutex:
+  std::lock_guard<std::mutex> lock(p_Counter.mutex);
+}
+//---------------------------------------------------------------------------//
+void
+JobSystem::parallelFor(uint32_t p_Count, uint32_t p_Grain, const RangeJob& p_Job)
+{
+  p_Grain = std::max(1u, p_Grain);
+  const uint32_t ranges = p_Count / p_Grain + (0 != p_Count % p_Grain);
+  if (ranges <= 1 || getThreadCount() <= 1)
+  {
+    if (p_Count > 0)
+      p_Job(0, p_Count, getWorkerIndex());
+    return;
+  }
+  CallerSlot slot;
+
+  // small enough for std::function to store without allocating:
+  struct Range
+  {
+    const RangeJob* job;
+    uint32_t begin;
+    uint32_t end;
+    void operator ()() const { (*job)(begin, end, getWorkerIndex()); }
+  };
+
+  JobCounter counter;
+  for (uint32_t begin = 0; begin < p_Count; begin += p_Grain)
+    run(counter, Range{ &p_Job, begin, std::min(begin + p_Grain, p_Count) });
+  wait(counter);
+}
+//---------------------------------------------------------------------------//
+void
+JobSystem::parallelRanges(uint32_t p_Count, uint32_t p_Grain, const std::function<void(uint32_t, uint32_t)>& p_Job)
+{
+  parallelFor(p_Count, p_Grain, [&](uint32_t p_Begin, uint32_t p_End, uint32_t) { p_Job(p_Begin, p_End); });
+}
+//---------------------------------------------------------------------------//
+void
+JobSystem::setThreadCount(uint32_t p_Count)
+{
+  std::lock_guard<std::mutex> lock(g_Jobs.configMutex);
+  g_Jobs.stop();
+  g_Jobs.start(p_Count);
+}
+//---------------------------------------------------------------------------//
+uint32_t
+JobSystem::getThreadCount()
+{
+  ensureStarted();
+  return g_Jobs.threadCount;
+}
+//---------------------------------------------------------------------------//
+uint32_t
+JobSystem::getSlotCount()
+{
+  ensureStarted();
+  return g_Jobs.injectSlot;
+}
+//---------------------------------------------------------------------------//
+uint32_t
+JobSystem::getWorkerIndex()
+{
+  return ms_NoWorker == t_WorkerIndex ? 0 : t_WorkerIndex;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct JobCounter;
+
+//---------------------------------------------------------------------------//
+// Job waiting in a deque, counted out of p_Counter once it ran
+struct QueuedJob
+{
+  std::function<void()> function;
+  JobCounter* counter = nullptr;
+};
+//---------------------------------------------------------------------------//
+// Jobs started with it that have not finished yet. Lives on the stack of the
+// code that waits for it and must outlive its jobs.
+//---------------------------------------------------------------------------//
+struct JobCounter
+{
+  std::atomic<uint32_t> pending = 0;
+
+  // jobs handed to runAfter while pending was not zero
+  std::mutex mutex;
+  std::vector<QueuedJob> continuations;
+};
+
+//---------------------------------------------------------------------------//
+// Work-stealing job system. Every thread owns a deque: it pushes and pops its
+// own jobs at the back (newest first, still warm in the cache) and idle
+// threads steal the oldest jobs from the front of the others, so uneven work
+// spreads out without a central queue.
+//
+// Threads outside the pool (the front-end's main thread, the asset loader
+// threads) take one of a few caller slots while they wait for jobs: every
+// caller gets a deque of its own and works through it and the others, so
+// callers never hold each other up. Jobs queued from outside without
+// waiting go to a shared deque the workers steal from.
+//---------------------------------------------------------------------------//
+struct JobSystem
+{
+  using Job = std::function<void()>;
+  using RangeJob = std::function<void(uint32_t p_Begin, uint32_t p_End, uint32_t p_Worker)>;
+
+  //---------------------------------------------------------------------------//
+  // Queues p_Job on the calling thread's deque, counted in p_Counter
+  static void
+  run(JobCounter& p_Counter, Job p_Job);
+  //---------------------------------------------------------------------------//
+  // Queues p_Job once p_Dependency dropped to zero, counted in p_Counter from
+  // now on so waiting for p_Counter covers it
+  static void
+  runAfter(JobCounter& p_Dependency, JobCounter& p_Counter, Job p_Job);
+  //---------------------------------------------------------------------------//
+  // Runs queued jobs (own or stolen) until p_Counter is zero
+  static void
+  wait(JobCounter& p_Counter);
+  //---------------------------------------------------------------------------//
+  // Splits [0, p_Count) into ranges of p_Grain items, runs them as jobs and
+  // waits for all. p_Worker is below getSlotCount() and unique among the
+  // ranges of the call running at the same time, for per-worker scratch
+  // memory. A single range (or a single thread) runs inline on the caller.
+  static void
+  parallelFor(uint32_t p_Count, uint32_t p_Grain, const RangeJob& p_Job);
+  //---------------------------------------------------------------------------//
+  // parallelFor without the worker index, the parallel_for the tinyrenderer
+  // loaders take (tinyrenderer/parallel.h)
+  static void
+  parallelRanges(uint32_t p_Count, uint32_t p_Grain, const std::function<void(uint32_t, uint32_t)>& p_Job);
+  //---------------------------------------------------------------------------//
+  // Threads including slot 0, 0 picks std::thread::hardware_concurrency.
+  // Only call it while no jobs are queued or running.
+  static void
+  setThreadCount(uint32_t p_Count);
+  //---------------------------------------------------------------------------//
+  static uint32_t
+  getThreadCount();
+  //---------------------------------------------------------------------------//
+  // Pool threads plus caller slots, the bound of parallelFor's p_Worker
+  static uint32_t
+  getSlotCount();
+  //---------------------------------------------------------------------------//
+  // Slot of the calling thread, 0 outside the pool and the caller slots
+  static uint32_t
+  getWorkerIndex();
+};
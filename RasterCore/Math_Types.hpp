@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+//---------------------------------------------------------------------------//
+// Helper functions
+//---------------------------------------------------------------------------//
+template <typename T> inline T alignUp(T p_Val, T p_Alignment)
+{
+  return (p_Val + p_Alignment - (T)1) & ~(p_Alignment - (T)1);
+}
+//---------------------------------------------------------------------------//
+template <typename T, size_t N> constexpr size_t arrayCount(T(&)[N]) { return N; }
+//---------------------------------------------------------------------------//
+template <typename T, uint32_t N> constexpr uint32_t arrayCount32(T(&)[N]) { return N; }
+//---------------------------------------------------------------------------//
+inline int
+roundFloatToUInt(float p_Value)
+{
+  int result = (int)roundf(p_Value);
+  return(result);
+}
+
+//---------------------------------------------------------------------------//
+// Helper classes
+//---------------------------------------------------------------------------//
+
+template <typename T> struct Vector2
+{
+  union {
+    struct { T u, v; };
+    struct { T x, y; };
+    T raw[2];
+  };
+
+  Vector2() : u(0), v(0) {}
+  Vector2(T p_X, T p_Y) : x(p_X), y(p_Y) {}
+  inline Vector2<T> operator +(const Vector2<T>& p_V) const { return Vector2<T>(x + p_V.x, y + p_V.y); }
+  inline Vector2<T> operator -(const Vector2<T>& p_V) const { return Vector2<T>(x - p_V.x, y - p_V.y); }
+  inline Vector2<T> operator *(float p_Scalar)     const
+  {
+    return Vector2<T>(static_cast<T>(x * p_Scalar), static_cast<T>(y * p_Scalar));
+  }
+};
+typedef Vector2<float> Vec2F;
+typedef Vector2<int>   Vec2I;
+
+//---------------------------------------------------------------------------//
+template <typename T> struct Vector3 {
+  union {
+    struct { T x, y, z; };
+    T raw[3];
+  };
+  constexpr Vector3() : raw{ 0, 0, 0 } {}
+  Vector3(const T p_Raw[3]) : raw{ p_Raw[0], p_Raw[1], p_Raw[2] } {}
+
+  // NOTE(OM): constexpr ctor is for allowing constant initialization.
+  // it does not mean all instances will be literal / constant expressions:
+  // https://en.cppreference.com/w/cpp/language/constexpr
+  // Only one member of the union can be initialized (GCC/Clang reject more),
+  // x, y and z alias raw so initializing raw is enough.
+  constexpr Vector3(T p_X, T p_Y, T p_Z) : raw{ p_X, p_Y, p_Z } {}
+
+  inline Vector3<T> operator +(const Vector3<T>& p_Vec) const
+  {
+    return Vector3<T>(x + p_Vec.x, y + p_Vec.y, z + p_Vec.z);
+  }
+  inline Vector3<T> operator -(const Vector3<T>& p_Vec) const
+  {
+    return Vector3<T>(x - p_Vec.x, y - p_Vec.y, z - p_Vec.z);
+  }
+  inline Vector3<T> operator *(float p_Val) const
+  {
+    return Vector3<T>(x * p_Val, y * p_Val, z * p_Val);
+  }
+  inline T operator *(const Vector3<T>& p_Vec) const
+  {
+    return x * p_Vec.x + y * p_Vec.y + z * p_Vec.z;
+  }
+  float length() const { return std::sqrt(x * x + y * y + z * z); }
+  Vector3<T>& normalize() { *this = (*this) * (1 / length()); return *this; }
+
+  Vector3<T> normalized() const {
+    float len = length();
+    return Vector3<T>(x / len, y / len, z / len);
+  }
+
+  static Vector3<T> cross (const Vector3<T>& p_Vec0, const Vector3<T>& p_Vec1)
+  {
+    return Vector3<T>(
+      p_Vec0.y * p_Vec1.z - p_Vec0.z * p_Vec1.y,
+      p_Vec0.z * p_Vec1.x - p_Vec0.x * p_Vec1.z,
+      p_Vec0.x * p_Vec1.y - p_Vec0.y * p_Vec1.x
+    );
+  }
+
+  static float dot (const Vector3<T>& p_Vec0, const Vector3<T>& p_Vec1)
+  {
+    return p_Vec0.x * p_Vec1.x + p_Vec0.y * p_Vec1.y + p_Vec0.z * p_Vec1.z;
+  }
+};
+typedef Vector3<float> Vec3F;
+typedef Vector3<int>   Vec3I;
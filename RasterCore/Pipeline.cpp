@@ -0,0 +1,375 @@
+// Pipeline.cpp : model level render passes.
+// Description: fetch faces from a tinyrenderer Model, transform them with the
+// camera and hand the triangles to the raster functions
+//
+
+#include "Pipeline.hpp"
+#include "Job_System.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
+
+#include <tinyrenderer/model.h>
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+//---------------------------------------------------------------------------//
+// Pipeline functions
+//---------------------------------------------------------------------------//
+ViewTransform
+makeViewTransform(const Camera& p_Camera)
+{
+  // right handed basis with z pointing from target back to the eye:
+  ViewTransform view;
+  view.axisZ = (p_Camera.eye - p_Camera.target).normalized();
+  view.axisX = Vec3F::cross(p_Camera.up, view.axisZ).normalized();
+  view.axisY = Vec3F::cross(view.axisZ, view.axisX);
+  view.origin = p_Camera.target;
+  view.scale = p_Camera.scale;
+  return view;
+}
+//---------------------------------------------------------------------------//
+Vec3F
+worldToView(const ViewTransform& p_View, Vec3F p_VecWS)
+{
+  Vec3F v = p_VecWS - p_View.origin;
+  return Vec3F(
+    Vec3F::dot(v, p_View.axisX) * p_View.scale,
+    Vec3F::dot(v, p_View.axisY) * p_View.scale,
+    Vec3F::dot(v, p_View.axisZ) * p_View.scale);
+}
+//---------------------------------------------------------------------------//
+// Restrict has to sit on parameters for gcc to drop the aliasing checks
+// between the nine streams and vectorize the loop
+static void
+transformSpan(const ViewTransform& p_View, float p_Width, float p_Height, size_t p_Begin, size_t p_End,
+  const float* __restrict p_InX, const float* __restrict p_InY, const float* __restrict p_InZ,
+  float* __restrict p_ViewX, float* __restrict p_ViewY, float* __restrict p_ViewZ,
+  float* __restrict p_ScreenX, float* __restrict p_ScreenY, float* __restrict p_ScreenZ)
+{
+  // plain floats, the Vec3F unions would be reloaded every iteration:
+  const float originX = p_View.origin.x, originY = p_View.origin.y, originZ = p_View.origin.z;
+  const float xx = p_View.axisX.x, xy = p_View.axisX.y, xz = p_View.axisX.z;
+  const float yx = p_View.axisY.x, yy = p_View.axisY.y, yz = p_View.axisY.z;
+  const float zx = p_View.axisZ.x, zy = p_View.axisZ.y, zz = p_View.axisZ.z;
+  const float scale = p_View.scale;
+
+  // same operations in the same order as worldToView and worldToScreen:
+  for (size_t i = p_Begin; i < p_End; i++)
+  {
+    const float x = p_InX[i] - originX;
+    const float y = p_InY[i] - originY;
+    const float z = p_InZ[i] - originZ;
+    const float vx = (x * xx + y * xy + z * xz) * scale;
+    const float vy = (x * yx + y * yy + z * yz) * scale;
+    const float vz = (x * zx + y * zy + z * zz) * scale;
+    p_ViewX[i] = vx;
+    p_ViewY[i] = vy;
+    p_ViewZ[i] = vz;
+    p_ScreenX[i] = (vx + 1.0f) * p_Width / 2.0f;
+    p_ScreenY[i] = (vy + 1.0f) * p_Height / 2.0f;
+    p_ScreenZ[i] = vz;
+  }
+}
+//---------------------------------------------------------------------------//
+void
+transformVertices(const Framebuffer& p_Fb, const ViewTransform& p_View, const VertexBuffer& p_Model,
+  uint32_t p_Begin, uint32_t p_End, VertexBuffer& p_ViewSpace, VertexBuffer& p_Screen)
+{
+  transformSpan(p_View, (float)p_Fb.width, (float)p_Fb.height, p_Begin, p_End,
+    p_Model.x.data(), p_Model.y.data(), p_Model.z.data(),
+    p_ViewSpace.x.data(), p_ViewSpace.y.data(), p_ViewSpace.z.data(),
+    p_Screen.x.data(), p_Screen.y.data(), p_Screen.z.data());
+}
+//---------------------------------------------------------------------------//
+// Model positions as a VertexBuffer
+static void
+fetchVertices(const Model& p_Model, VertexBuffer& p_Positions)
+{
+  const std::span<const Vec3f> verts = p_Model.verts();
+  p_Positions.resize(verts.size());
+  for (size_t i = 0; i < verts.size(); i++)
+  {
+    p_Positions.x[i] = verts[i].x;
+    p_Positions.y[i] = verts[i].y;
+    p_Positions.z[i] = verts[i].z;
+  }
+}
+//---------------------------------------------------------------------------//
+// Calls p_Fn with the model's index buffer, a span of uint16_t or uint32_t
+template <typename Fn>
+static void
+withIndices(const Model& p_Model, Fn&& p_Fn)
+{
+  if (p_Model.has_indices16())
+    p_Fn(p_Model.indices16());
+  else
+    p_Fn(p_Model.indices32());
+}
+//---------------------------------------------------------------------------//
+// Vertices per transform job, enough work to amortize queueing it
+static constexpr uint32_t ms_VertexGrain = 4096;
+//---------------------------------------------------------------------------//
+static void
+transformModel(const Framebuffer& p_Fb, const ViewTransform& p_View, const VertexBuffer& p_Positions,
+  VertexBuffer& p_ViewSpace, VertexBuffer& p_Screen)
+{
+  const uint32_t vertCount = (uint32_t)p_Positions.size();
+  p_ViewSpace.resize(vertCount);
+  p_Screen.resize(vertCount);
+  JobSystem::parallelFor(vertCount, ms_VertexGrain, [&](uint32_t p_Begin, uint32_t p_End, uint32_t) {
+    transformVertices(p_Fb, p_View, p_Positions, p_Begin, p_End, p_ViewSpace, p_Screen);
+  });
+}
+//---------------------------------------------------------------------------//
+void
+drawModelWireframe(Framebuffer& p_Fb, const Model& p_Model, const Camera& p_Camera, uint32_t p_Color)
+{
+  RASTER_PROFILE_ZONE("wireframe");
+  const ViewTransform view = makeViewTransform(p_Camera);
+  if (p_Fb.stats)
+  {
+    p_Fb.stats->beginDraw();
+    p_Fb.stats->current.facesSubmitted = p_Model.nfaces();
+  }
+
+  VertexBuffer positions, viewSpace, screen;
+  fetchVertices(p_Model, positions);
+  transformModel(p_Fb, view, positions, viewSpace, screen);
+
+  withIndices(p_Model, [&](auto p_Indices) {
+    for (size_t i = 0; i < p_Indices.size(); i += 3)
+    {
+      const auto* face = &p_Indices[i];
+      for (int j = 0; j < 3; j++) {
+        const uint32_t i0 = face[j];
+        const uint32_t i1 = face[(j + 1) % 3];
+        drawLineSimple(p_Fb,
+          roundFloatToUInt(screen.x[i0]), roundFloatToUInt(screen.y[i0]),
+          roundFloatToUInt(screen.x[i1]), roundFloatToUInt(screen.y[i1]), p_Color);
+      }
+    }
+  });
+
+  if (p_Fb.stats)
+    p_Fb.stats->endDraw();
+}
+//---------------------------------------------------------------------------//
+// Light travels along the view direction (a "headlight")
+static constexpr Vec3F ms_LightDir = Vec3F(0.0f, 0.0f, -1.0f);
+//---------------------------------------------------------------------------//
+// Lambert intensity of every face and the screen triangles of those facing
+// the light. p_Indices holds three vertex indices per face, anything with
+// operator []. With p_Uvs set it gets the corners' p_VertexUvs (zero when
+// empty) of every screen triangle.
+template <typename Indices>
+static void
+shadeFaces(uint32_t p_FaceCount, const Indices& p_Indices, const VertexBuffer& p_ViewSpace, const VertexBuffer& p_Screen,
+  std::vector<float>& p_Intensities, std::vector<ScreenTriangle>& p_Triangles,
+  std::span<const Vec2f> p_VertexUvs = {}, std::vector<TriangleUvs>* p_Uvs = nullptr)
+{
+  p_Intensities.resize(p_FaceCount);
+  {
+    RASTER_PROFILE_ZONE("shade");
+    JobSystem::parallelFor(p_FaceCount, ms_VertexGrain / 3, [&](uint32_t p_Begin, uint32_t p_End, uint32_t) {
+      for (uint32_t i = p_Begin; i < p_End; i++)
+      {
+        const Vec3F v0 = p_ViewSpace[p_Indices[3 * (size_t)i]];
+        const Vec3F v1 = p_ViewSpace[p_Indices[3 * (size_t)i + 1]];
+        const Vec3F v2 = p_ViewSpace[p_Indices[3 * (size_t)i + 2]];
+
+        // Apply intensity through dot product: (Lambert cosine law)
+        Vec3F n = Vec3F::cross(v2 - v0, v1 - v0);
+        n.normalize();
+        p_Intensities[i] = Vec3F::dot(n, ms_LightDir);
+      }
+    });
+  }
+  {
+    RASTER_PROFILE_ZONE("setup");
+    p_Triangles.clear();
+    p_Triangles.reserve(p_FaceCount);
+    if (p_Uvs)
+    {
+      p_Uvs->clear();
+      p_Uvs->reserve(p_FaceCount);
+    }
+    for (uint32_t i = 0; i < p_FaceCount; i++)
+    {
+      if (!(p_Intensities[i] > 0))
+        continue;
+
+      ScreenTriangle tri;
+      for (int j = 0; j < 3; j++)
+        tri.pos[j] = p_Screen[p_Indices[3 * (size_t)i + j]];
+      tri.color = (Colors::White * p_Intensities[i]).convertToUint32();
+      p_Triangles.push_back(tri);
+
+      if (p_Uvs)
+      {
+        TriangleUvs uvs;
+        if (!p_VertexUvs.empty())
+        {
+          for (int j = 0; j < 3; j++)
+          {
+            const Vec2f& uv = p_VertexUvs[p_Indices[3 * (size_t)i + j]];
+            uvs.uv[j] = Vec2F(uv.u, uv.v);
+          }
+        }
+        p_Uvs->push_back(uvs);
+      }
+    }
+  }
+}
+//---------------------------------------------------------------------------//
+// Runs as separate stages over the whole model so each one shows up as a
+// single zone in the profiler, transform and shade split into jobs:
+//   fetch -> transform -> shade -> setup -> raster
+// Vertices are transformed once into a post-transform buffer that the later
+// stages index, shared corners are not transformed again per face.
+// p_Texture, when set, is multiplied into the Lambert color.
+static void
+drawModelLambert(Framebuffer& p_Fb, const Model& p_Model, const Camera& p_Camera, bool p_DepthTest,
+  const Texture* p_Texture = nullptr)
+{
+  const ViewTransform view = makeViewTransform(p_Camera);
+  const int faceCount = p_Model.nfaces();
+
+  VertexBuffer positions;
+  VertexBuffer viewSpace;
+  VertexBuffer screen;
+  std::vector<float> intensities;
+  std::vector<ScreenTriangle> triangles;
+  std::vector<TriangleUvs> uvs;
+
+  if (p_Fb.stats)
+    p_Fb.stats->beginDraw();
+
+  {
+    RASTER_PROFILE_ZONE("fetch");
+    fetchVertices(p_Model, positions);
+  }
+  {
+    RASTER_PROFILE_ZONE("transform");
+    transformModel(p_Fb, view, positions, viewSpace, screen);
+  }
+  withIndices(p_Model, [&](auto p_Indices) {
+    shadeFaces((uint32_t)faceCount, p_Indices, viewSpace, screen, intensities, triangles,
+      p_Model.uvs(), p_Texture ? &uvs : nullptr);
+  });
+  {
+    RASTER_PROFILE_ZONE("raster");
+    if (p_Texture)
+      drawTrianglesTextured(p_Fb, triangles.data(), uvs.data(), triangles.size(), *p_Texture, p_DepthTest);
+    else
+      drawTriangles(p_Fb, triangles.data(), triangles.size(), p_DepthTest);
+  }
+
+  if (p_Fb.stats)
+  {
+    p_Fb.stats->current.facesSubmitted = faceCount;
+    p_Fb.stats->current.facesCulled = faceCount - triangles.size();
+    p_Fb.stats->endDraw();
+  }
+}
+//---------------------------------------------------------------------------//
+void
+drawModelFlat(Framebuffer& p_Fb, const Model& p_Model, const Camera& p_Camera)
+{
+  drawModelLambert(p_Fb, p_Model, p_Camera, false);
+}
+//---------------------------------------------------------------------------//
+void
+drawModelDepth(Framebuffer& p_Fb, const Model& p_Model, const Camera& p_Camera)
+{
+  drawModelLambert(p_Fb, p_Model, p_Camera, nullptr != p_Fb.depth);
+}
+//---------------------------------------------------------------------------//
+void
+drawModelTextured(Framebuffer& p_Fb, const Model& p_Model, const Texture& p_Texture, const Camera& p_Camera)
+{
+  drawModelLambert(p_Fb, p_Model, p_Camera, nullptr != p_Fb.depth, p_Texture.isValid() ? &p_Texture : nullptr);
+}
+//---------------------------------------------------------------------------//
+// Streaming
+//---------------------------------------------------------------------------//
+// Memory a streamed triangle costs on the way through the pipeline: indices,
+// corner positions, view and screen space, intensity, the screen triangle and
+// its setup in drawTriangles, rounded up
+static constexpr size_t ms_StreamBytesPerTriangle = 512;
+static constexpr size_t ms_MinStreamBatch = 1024;
+//---------------------------------------------------------------------------//
+// Corners are transformed per face here, a batch has no index buffer of its
+// own to share them. Same operations in the same order as drawModelLambert,
+// so the image comes out the same.
+bool
+drawModelStreamed(Framebuffer& p_Fb, const char* p_Path, const Camera& p_Camera, bool p_DepthTest, size_t p_BudgetBytes,
+  bool p_UseCache)
+{
+  // half the budget for the two read blocks and the obj positions kept in
+  // memory (a block's worth each), half for the batch in flight:
+  const size_t blockBytes = p_BudgetBytes / 6;
+  const size_t batchTriangles = std::max(ms_MinStreamBatch, p_BudgetBytes / 2 / ms_StreamBytesPerTriangle);
+  ModelStream stream(p_Path, blockBytes, batchTriangles, p_UseCache);
+  if (!stream.initialized)
+    return false;
+
+  const ViewTransform view = makeViewTransform(p_Camera);
+  VertexBuffer positions;
+  VertexBuffer viewSpace;
+  VertexBuffer screen;
+  std::vector<float> intensities;
+  std::vector<ScreenTriangle> triangles;
+  struct IdentityIndices
+  {
+    uint32_t operator [](size_t p_Index) const { return (uint32_t)p_Index; }
+  };
+
+  if (p_Fb.stats)
+    p_Fb.stats->beginDraw();
+
+  size_t faceCount = 0;
+  size_t drawnCount = 0;
+  while (true)
+  {
+    {
+      RASTER_PROFILE_ZONE("read");
+      if (!stream.next_batch())
+        break;
+    }
+    const std::span<const Vec3f> verts = stream.verts();
+    const std::span<const uint32_t> corners = stream.triangles();
+    {
+      RASTER_PROFILE_ZONE("fetch");
+      positions.resize(corners.size());
+      for (size_t i = 0; i < corners.size(); i++)
+      {
+        const Vec3f& v = verts[corners[i]];
+        positions.x[i] = v.x;
+        positions.y[i] = v.y;
+        positions.z[i] = v.z;
+      }
+    }
+    {
+      RASTER_PROFILE_ZONE("transform");
+      transformModel(p_Fb, view, positions, viewSpace, screen);
+    }
+    const uint32_t batchFaces = (uint32_t)(corners.size() / 3);
+    shadeFaces(batchFaces, IdentityIndices(), viewSpace, screen, intensities, triangles);
+    {
+      RASTER_PROFILE_ZONE("raster");
+      drawTriangles(p_Fb, triangles.data(), triangles.size(), p_DepthTest);
+    }
+    faceCount += batchFaces;
+    drawnCount += triangles.size();
+  }
+
+  if (p_Fb.stats)
+  {
+    p_Fb.stats->current.facesSubmitted = faceCount;
+    p_Fb.stats->current.facesCulled = faceCount - drawnCount;
+    p_Fb.stats->endDraw();
+  }
+  return !stream.failed();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Raster.hpp"
+
+#include <vector>
+
+class Model;
+class Texture;
+
+//---------------------------------------------------------------------------//
+// Orthographic camera looking from eye to target. The default camera is the
+// identity view: model space [-1, 1] maps straight onto the framebuffer.
+//---------------------------------------------------------------------------//
+struct Camera
+{
+  Vec3F eye = Vec3F(0.0f, 0.0f, 1.0f);
+  Vec3F target = Vec3F(0.0f, 0.0f, 0.0f);
+  Vec3F up = Vec3F(0.0f, 1.0f, 0.0f);
+
+  // zoom factor applied after the view rotation
+  float scale = 1.0f;
+};
+//---------------------------------------------------------------------------//
+struct ViewTransform
+{
+  Vec3F axisX;
+  Vec3F axisY;
+  Vec3F axisZ;
+  Vec3F origin;
+  float scale;
+};
+
+//---------------------------------------------------------------------------//
+// Vertex positions in structure of arrays layout, so the transform loop works
+// on whole simd registers of x, y and z
+struct VertexBuffer
+{
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+
+  void resize(size_t p_Count) { x.resize(p_Count); y.resize(p_Count); z.resize(p_Count); }
+  size_t size() const { return x.size(); }
+  Vec3F operator [](size_t p_Index) const { return Vec3F(x[p_Index], y[p_Index], z[p_Index]); }
+};
+
+//---------------------------------------------------------------------------//
+// Pipeline functions
+//---------------------------------------------------------------------------//
+ViewTransform
+makeViewTransform(const Camera& p_Camera);
+//---------------------------------------------------------------------------//
+Vec3F
+worldToView(const ViewTransform& p_View, Vec3F p_VecWS);
+//---------------------------------------------------------------------------//
+// Post-transform stage: worldToView and worldToScreen of the vertices
+// [p_Begin, p_End), bit identical to calling them one vertex at a time.
+// p_Screen.z is the view space depth.
+void
+transformVertices(const Framebuffer& p_Fb, const ViewTransform& p_View, const VertexBuffer& p_Model,
+  uint32_t p_Begin, uint32_t p_End, VertexBuffer& p_ViewSpace, VertexBuffer& p_Screen);
+//---------------------------------------------------------------------------//
+// 'W': model edges as lines
+void
+drawModelWireframe(Framebuffer& p_Fb, const Model& p_Model, const Camera& p_Camera, uint32_t p_Color);
+//---------------------------------------------------------------------------//
+// 'S': flat Lambert shading, no depth testing
+void
+drawModelFlat(Framebuffer& p_Fb, const Model& p_Model, const Camera& p_Camera);
+//---------------------------------------------------------------------------//
+// 'D': flat Lambert shading with depth testing, needs p_Fb.depth
+void
+drawModelDepth(Framebuffer& p_Fb, const Model& p_Model, const Camera& p_Camera);
+//---------------------------------------------------------------------------//
+// 'T': drawModelDepth with the Lambert color multiplied by p_Texture, sampled
+// bilinearly at the model's texture coordinates. An empty texture draws like
+// drawModelDepth.
+void
+drawModelTextured(Framebuffer& p_Fb, const Model& p_Model, const Texture& p_Texture, const Camera& p_Camera);
+//---------------------------------------------------------------------------//
+// 'S'/'D' for models too large to load: reads p_Path (obj or mesh cache) a
+// batch of triangles at a time through a ModelStream and renders each batch
+// into the framebuffer before reading on. p_BudgetBytes bounds the memory
+// the draw holds: the read blocks, the per-batch buffers and the obj
+// positions not yet spilled to a mapped temporary file (see ModelStream).
+// Returns false when the file can't be read or parsed.
+bool
+drawModelStreamed(Framebuffer& p_Fb, const char* p_Path, const Camera& p_Camera, bool p_DepthTest, size_t p_BudgetBytes,
+  bool p_UseCache = true);
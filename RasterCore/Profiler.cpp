@@ -0,0 +1,151 @@
+// Profiler.cpp : frame zone recording and chrome trace export.
+//
+
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//---------------------------------------------------------------------------//
+// Thread buffers
+//---------------------------------------------------------------------------//
+// Events of one thread. Only the owner records into it, so its mutex is
+// uncontended except while writeChromeTrace copies the events out (loader
+// threads may still be recording then).
+struct ThreadEvents
+{
+  std::mutex mutex;
+  std::vector<Profiler::Event> events;
+  uint64_t generation = 0; // Profiler::ms_FrameGeneration the events belong to
+  uint32_t threadId = 0;
+};
+//---------------------------------------------------------------------------//
+// Buffers outlive their threads (the pools restart theirs on setThreadCount)
+// and are only added to, the registry lock is taken once per thread
+struct ThreadRegistry
+{
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadEvents>> threads;
+};
+//---------------------------------------------------------------------------//
+// Never destroyed: the loader threads are joined during static destruction
+// and may still close a zone
+static ThreadRegistry&
+getRegistry()
+{
+  static ThreadRegistry* s_Registry = new ThreadRegistry;
+  return *s_Registry;
+}
+//---------------------------------------------------------------------------//
+// Small stable ids (the registration order) read better in the trace viewer
+// than native handles
+static ThreadEvents&
+getThreadEvents()
+{
+  thread_local ThreadEvents* t_Events = nullptr;
+
+  if (nullptr == t_Events)
+  {
+    ThreadRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(std::make_unique<ThreadEvents>());
+    t_Events = registry.threads.back().get();
+    t_Events->threadId = (uint32_t)registry.threads.size() - 1;
+  }
+  return *t_Events;
+}
+
+//---------------------------------------------------------------------------//
+// Profiler
+//---------------------------------------------------------------------------//
+uint64_t
+Profiler::nowNs()
+{
+  using Clock = std::chrono::steady_clock;
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+//---------------------------------------------------------------------------//
+void
+Profiler::beginFrame()
+{
+  if (!ms_Enabled)
+    return;
+
+  ms_FrameBeginNs = nowNs();
+  ms_FrameGeneration.fetch_add(1);
+}
+//---------------------------------------------------------------------------//
+void
+Profiler::endFrame()
+{
+  if (!ms_Enabled)
+    return;
+
+  record("frame", ms_FrameBeginNs, nowNs());
+  ms_FrameIndex++;
+}
+//---------------------------------------------------------------------------//
+void
+Profiler::record(const char* p_Name, uint64_t p_BeginNs, uint64_t p_EndNs)
+{
+  ThreadEvents& thread = getThreadEvents();
+  const uint64_t generation = ms_FrameGeneration.load(std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(thread.mutex);
+  if (thread.generation != generation)
+  {
+    thread.events.clear();
+    thread.generation = generation;
+  }
+  thread.events.push_back({ p_Name, p_BeginNs, p_EndNs, thread.threadId });
+}
+//---------------------------------------------------------------------------//
+bool
+Profiler::writeChromeTrace(const char* p_Path)
+{
+  std::vector<Event> events;
+  {
+    const uint64_t generation = ms_FrameGeneration.load();
+    ThreadRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> registryLock(registry.mutex);
+    for (const std::unique_ptr<ThreadEvents>& thread : registry.threads)
+    {
+      std::lock_guard<std::mutex> lock(thread->mutex);
+      if (thread->generation == generation)
+        events.insert(events.end(), thread->events.begin(), thread->events.end());
+    }
+  }
+  std::sort(events.begin(), events.end(), [](const Event& p_A, const Event& p_B) { return p_A.beginNs < p_B.beginNs; });
+
+  FILE* file = fopen(p_Path, "w");
+  if (nullptr == file)
+  {
+    fprintf(stderr, "can't open trace file %s\n", p_Path);
+    return false;
+  }
+
+  // complete ("X") events, timestamps in microseconds relative to the frame:
+  fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  for (size_t i = 0; i < events.size(); ++i)
+  {
+    const Event& e = events[i];
+    const double ts = (double)(int64_t)(e.beginNs - ms_FrameBeginNs) / 1000.0;
+    const double dur = (double)(e.endNs - e.beginNs) / 1000.0;
+    fprintf(file,
+      "  {\"name\": \"%s\", \"cat\": \"raster\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": %u, \"args\": {\"frame\": %llu}}%s\n",
+      e.name, ts, dur, e.threadId, (unsigned long long)ms_FrameIndex - 1,
+      (i + 1 < events.size()) ? "," : "");
+  }
+  fprintf(file, "]}\n");
+
+  // fclose flushes the buffered tail, a full disk shows up there:
+  bool ok = 0 == ferror(file);
+  ok = 0 == fclose(file) && ok;
+  if (!ok)
+    fprintf(stderr, "can't write trace file %s\n", p_Path);
+  return ok;
+}
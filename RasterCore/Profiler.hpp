@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Zones compile to nothing unless the build defines RASTER_ENABLE_PROFILING=1
+// (cmake -DRASTER_PROFILING=ON)
+#ifndef RASTER_ENABLE_PROFILING
+#define RASTER_ENABLE_PROFILING 0
+#endif
+
+//---------------------------------------------------------------------------//
+// Collects timed zones of the current frame and dumps them in the chrome
+// trace event format (load in chrome://tracing or ui.perfetto.dev)
+//---------------------------------------------------------------------------//
+struct Profiler
+{
+  static constexpr bool ms_Enabled = RASTER_ENABLE_PROFILING;
+
+  struct Event
+  {
+    const char* name; // zone names are string literals
+    uint64_t beginNs;
+    uint64_t endNs;
+    uint32_t threadId;
+  };
+
+  // Each thread records into its own buffer, writeChromeTrace merges them
+  inline static std::atomic<uint64_t> ms_FrameGeneration = 0; // beginFrame calls
+  inline static uint64_t ms_FrameIndex = 0;
+  inline static uint64_t ms_FrameBeginNs = 0;
+
+  //---------------------------------------------------------------------------//
+  static uint64_t
+  nowNs();
+  //---------------------------------------------------------------------------//
+  // Drops the events of the previous frame, the thread buffers clear on
+  // their next record
+  static void
+  beginFrame();
+  //---------------------------------------------------------------------------//
+  // Records the frame itself as an event and advances the frame index
+  static void
+  endFrame();
+  //---------------------------------------------------------------------------//
+  static void
+  record(const char* p_Name, uint64_t p_BeginNs, uint64_t p_EndNs);
+  //---------------------------------------------------------------------------//
+  // Writes the events of the last frame of every thread ordered by begin
+  // time, returns false on io errors
+  static bool
+  writeChromeTrace(const char* p_Path);
+};
+
+//---------------------------------------------------------------------------//
+struct ProfileZone
+{
+  const char* m_Name;
+  uint64_t m_BeginNs;
+
+  explicit ProfileZone(const char* p_Name) : m_Name(p_Name), m_BeginNs(Profiler::nowNs()) {}
+  ~ProfileZone() { Profiler::record(m_Name, m_BeginNs, Profiler::nowNs()); }
+};
+
+#define RASTER_PROFILE_CONCAT_INNER(p_A, p_B) p_A##p_B
+#define RASTER_PROFILE_CONCAT(p_A, p_B) RASTER_PROFILE_CONCAT_INNER(p_A, p_B)
+
+#if RASTER_ENABLE_PROFILING
+#define RASTER_PROFILE_ZONE(p_Name) ProfileZone RASTER_PROFILE_CONCAT(profileZone, __LINE__)(p_Name)
+#else
+#define RASTER_PROFILE_ZONE(p_Name) ((void)0)
+#endif
@@ -0,0 +1,835 @@
+// Raster.cpp : platform independent drawing functions.
+// Description: everything here writes into a Framebuffer, so the same code
+// runs behind the SWC swapchain backbuffer and the headless renderer
+//
+
+#include "Raster.hpp"
+#include "Raster_Kernels.hpp"
+#include "Job_System.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#if RASTER_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+//---------------------------------------------------------------------------//
+// Rendering functions
+//---------------------------------------------------------------------------//
+// Rows per clear job, 64 rows of 4K are 1 MB of stores
+static constexpr uint32_t ms_ClearRowGrain = 64;
+//---------------------------------------------------------------------------//
+void
+colorPixel (Framebuffer& p_Fb, int p_X, int p_Y, uint32_t p_Color)
+{
+  if (p_Fb.flipVertically)
+    p_Y = p_Fb.height - 1 - p_Y;
+
+  if (p_X < 0 || p_X >= p_Fb.width
+    || p_Y < 0 || p_Y >= p_Fb.height) {
+    return;
+  }
+
+  p_Fb.color[p_Y * p_Fb.width + p_X] = p_Color;
+}
+//---------------------------------------------------------------------------//
+void
+clearBuffer(Framebuffer& p_Fb, uint32_t p_Color)
+{
+  RASTER_PROFILE_ZONE("clear");
+  JobSystem::parallelFor((uint32_t)p_Fb.height, ms_ClearRowGrain, [&](uint32_t p_Begin, uint32_t p_End, uint32_t) {
+    uint8_t* row = (uint8_t*)p_Fb.color + (size_t)p_Begin * p_Fb.width * Framebuffer::ms_BytePerPixel;
+
+    for (uint32_t y = p_Begin; y < p_End; ++y) {
+      uint32_t* pixel = (uint32_t*)row;
+      for (int x = 0; x < p_Fb.width; ++x)
+      {
+        *pixel = p_Color;
+        ++pixel;
+      }
+
+      // move to next rowPitch:
+      row += p_Fb.width * Framebuffer::ms_BytePerPixel;
+    }
+  });
+}
+//---------------------------------------------------------------------------//
+void
+clearDepthBuffer(Framebuffer& p_Fb)
+{
+  RASTER_PROFILE_ZONE("clearDepth");
+  if (nullptr == p_Fb.depth)
+    return;
+
+  JobSystem::parallelFor((uint32_t)p_Fb.height, ms_ClearRowGrain, [&](uint32_t p_Begin, uint32_t p_End, uint32_t) {
+    std::fill(p_Fb.depth + (size_t)p_Begin * p_Fb.width, p_Fb.depth + (size_t)p_End * p_Fb.width,
+      -std::numeric_limits<float>::max());
+  });
+}
+//---------------------------------------------------------------------------//
+void
+drawHorizonatalLine(Framebuffer& p_Fb, const int p_LineY)
+{
+  for (int y = 0; y < p_Fb.height; ++y) {
+    for (int x = 0; x < p_Fb.width; ++x)
+    {
+      if (p_LineY == y)
+        colorPixel(p_Fb, x, y, BLUE);
+      else
+        colorPixel(p_Fb, x, y, WHITE);
+    }
+  }
+}
+//---------------------------------------------------------------------------//
+void
+drawVerticalLine(Framebuffer& p_Fb, const int p_LineX)
+{
+  for (int y = 0; y < p_Fb.height; ++y) {
+    for (int x = 0; x < p_Fb.width; ++x)
+    {
+      if (p_LineX == x)
+        colorPixel(p_Fb, x, y, BLUE);
+      else
+        colorPixel(p_Fb, x, y, WHITE);
+    }
+  }
+}
+//---------------------------------------------------------------------------//
+void
+drawLineSimple(Framebuffer& p_Fb, int p_X0, int p_Y0, int p_X1, int p_Y1, uint32_t p_Color)
+{
+  // if the line is steep, we transpose the image
+  bool steep = false;
+  if (std::abs(p_X0 - p_X1) < std::abs(p_Y0 - p_Y1))
+  {
+    std::swap(p_X0, p_Y0);
+    std::swap(p_X1, p_Y1);
+    steep = true;
+  }
+  // make it left-to-right
+  if (p_X0 > p_X1)
+  {
+    std::swap(p_X0, p_X1);
+    std::swap(p_Y0, p_Y1);
+  }
+  for (int x = p_X0; x <= p_X1; x++) {
+
+    // interpolate y based on x ratio (guard the single point line):
+    float t = (p_X1 == p_X0) ? 0.0f : (x - p_X0) / (float)(p_X1 - p_X0);
+    float yLerped = p_Y0 * (1.0f - t) + p_Y1 * t;
+    int y = roundFloatToUInt(yLerped);
+
+    if (steep) {
+      colorPixel(p_Fb, y, x, p_Color);
+    }
+    else {
+      colorPixel(p_Fb, x, y, p_Color);
+    }
+  }
+}
+//---------------------------------------------------------------------------//
+// https://github.com/ssloy/tinyrenderer/wiki/Lesson-2:-Triangle-rasterization-and-back-face-culling
+Vec3F
+barycentric(const Vec3F p_TriangleVertices[3], Vec3F p_Point) {
+  Vec3F vec0 = Vec3F(
+    (float)p_TriangleVertices[2].x - p_TriangleVertices[0].x,
+    (float)p_TriangleVertices[1].x - p_TriangleVertices[0].x,
+    (float)p_TriangleVertices[0].x - p_Point.x);
+
+  Vec3F vec1 = Vec3F(
+    (float)p_TriangleVertices[2].y - p_TriangleVertices[0].y,
+    (float)p_TriangleVertices[1].y - p_TriangleVertices[0].y,
+    (float)p_TriangleVertices[0].y - p_Point.y);
+
+  Vec3F u = Vec3F::cross(vec0, vec1);
+
+  /*
+    `p_TriangleVertices` and `p_Point` has integer value as coordinates
+    so `abs(u[2])` < 1 means `u[2]` is 0, that means
+    triangle is degenerate, in this case return something with negative coordinates
+  */
+  if (std::abs(u.z) < 1) return Vec3F(-1, 1, 1);
+
+  // Again dont forget that u[2] is integer.
+  // If it is zero then triangle ABC is degenerate
+  if (std::abs(u.z) > 1e-2) //
+    return Vec3F(1.f - (u.x + u.y) / u.z, u.y / u.z, u.x / u.z);
+
+  // return smth with negative by default
+  return Vec3F(-1, 1, 1);
+}
+//---------------------------------------------------------------------------//
+// Triangle setup
+//---------------------------------------------------------------------------//
+static constexpr int ms_SubPixelBits = 4;
+static constexpr int64_t ms_SubPixelOne = 1 << ms_SubPixelBits;
+static constexpr int64_t ms_SubPixelHalf = ms_SubPixelOne / 2;
+
+// keeps the 28.4 edge function products inside int64:
+static constexpr float ms_GuardBand = (float)(1 << 24);
+
+// clipped corners land on this box, far outside any framebuffer and small
+// enough that a float corner is within 1/64 pixel of the clipped edge
+static constexpr float ms_ClipBand = (float)(1 << 18);
+//---------------------------------------------------------------------------//
+static inline int64_t
+snapToSubPixel(float p_Value)
+{
+  return (int64_t)llroundf(p_Value * (float)ms_SubPixelOne);
+}
+//---------------------------------------------------------------------------//
+bool
+isInsideGuardBand(const Vec3F p_TriangleVertices[3])
+{
+  for (int i = 0; i < 3; i++) {
+    if (!(std::abs(p_TriangleVertices[i].x) < ms_GuardBand && std::abs(p_TriangleVertices[i].y) < ms_GuardBand))
+      return false;
+  }
+  return true;
+}
+//---------------------------------------------------------------------------//
+// Point of the segment p_A, p_B where p_Axis equals p_Bound. The endpoints are
+// ordered first, so the two triangles sharing an edge get the same corner.
+static Vec3F
+intersectClipPlane(Vec3F p_A, Vec3F p_B, int p_Axis, float p_Bound)
+{
+  if (std::lexicographical_compare(p_B.raw, p_B.raw + 3, p_A.raw, p_A.raw + 3))
+    std::swap(p_A, p_B);
+  const double t = ((double)p_Bound - p_A.raw[p_Axis]) / ((double)p_B.raw[p_Axis] - p_A.raw[p_Axis]);
+  Vec3F point;
+  for (int i = 0; i < 3; i++)
+    point.raw[i] = (float)(p_A.raw[i] + t * ((double)p_B.raw[i] - p_A.raw[i]));
+  point.raw[p_Axis] = p_Bound;
+  return point;
+}
+//---------------------------------------------------------------------------//
+void
+clipToGuardBand(const Vec3F p_TriangleVertices[3], ClippedTriangles& p_Clipped)
+{
+  p_Clipped.count = 0;
+  for (int i = 0; i < 3; i++) {
+    if (!std::isfinite(p_TriangleVertices[i].x) || !std::isfinite(p_TriangleVertices[i].y) || !std::isfinite(p_TriangleVertices[i].z))
+      return;
+  }
+
+  // Sutherland-Hodgman against -band <= x, x <= band, -band <= y, y <= band,
+  // every plane adds at most one corner:
+  Vec3F polygon[7] = { p_TriangleVertices[0], p_TriangleVertices[1], p_TriangleVertices[2] };
+  int count = 3;
+  for (int plane = 0; plane < 4; plane++)
+  {
+    const int axis = plane / 2;
+    const float bound = (plane & 1) ? ms_ClipBand : -ms_ClipBand;
+    auto inside = [&](const Vec3F& p_Corner) { return (plane & 1) ? p_Corner.raw[axis] <= bound : p_Corner.raw[axis] >= bound; };
+
+    Vec3F clipped[7];
+    int clippedCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+      const Vec3F& a = polygon[i];
+      const Vec3F& b = polygon[(i + 1) % count];
+      if (inside(a))
+        clipped[clippedCount++] = a;
+      if (inside(a) != inside(b))
+        clipped[clippedCount++] = intersectClipPlane(a, b, axis, bound);
+    }
+    std::copy(clipped, clipped + clippedCount, polygon);
+    count = clippedCount;
+    if (count < 3)
+      return;
+  }
+
+  for (int i = 1; i + 1 < count; i++)
+  {
+    Vec3F* corners = p_Clipped.corners[p_Clipped.count++];
+    corners[0] = polygon[0];
+    corners[1] = polygon[i];
+    corners[2] = polygon[i + 1];
+  }
+}
+//---------------------------------------------------------------------------//
+bool
+setupTriangle(const Framebuffer& p_Fb, const Vec3F p_TriangleVertices[3], TriangleSetup& p_Setup, bool& p_Degenerate)
+{
+  p_Degenerate = false;
+  if (!isInsideGuardBand(p_TriangleVertices))
+    return false;
+
+  int64_t x[3], y[3];
+  float z[3];
+  for (int i = 0; i < 3; i++) {
+    x[i] = snapToSubPixel(p_TriangleVertices[i].x);
+    y[i] = snapToSubPixel(p_TriangleVertices[i].y);
+    z[i] = p_TriangleVertices[i].z;
+  }
+
+  // twice the signed area, make the winding counter clockwise so inside is >= 0:
+  int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+  if (0 == area)
+  {
+    p_Degenerate = true;
+    return false;
+  }
+  if (area < 0)
+  {
+    std::swap(x[1], x[2]);
+    std::swap(y[1], y[2]);
+    std::swap(z[1], z[2]);
+    area = -area;
+  }
+
+  // pixels whose center lies inside the snapped bounding box, clamped:
+  const int64_t minXF = std::min({ x[0], x[1], x[2] });
+  const int64_t minYF = std::min({ y[0], y[1], y[2] });
+  const int64_t maxXF = std::max({ x[0], x[1], x[2] });
+  const int64_t maxYF = std::max({ y[0], y[1], y[2] });
+  auto firstCenter = [](int64_t p_Fixed) { return (p_Fixed - ms_SubPixelHalf + ms_SubPixelOne - 1) >> ms_SubPixelBits; };
+  auto lastCenter = [](int64_t p_Fixed) { return (p_Fixed - ms_SubPixelHalf) >> ms_SubPixelBits; };
+  p_Setup.minX = (int)std::max<int64_t>(0, firstCenter(minXF));
+  p_Setup.minY = (int)std::max<int64_t>(0, firstCenter(minYF));
+  p_Setup.maxX = (int)std::min<int64_t>(p_Fb.width - 1, lastCenter(maxXF));
+  p_Setup.maxY = (int)std::min<int64_t>(p_Fb.height - 1, lastCenter(maxYF));
+  if (p_Setup.minX > p_Setup.maxX || p_Setup.minY > p_Setup.maxY)
+    return false;
+  p_Setup.originX = p_Setup.minX;
+  p_Setup.originY = p_Setup.minY;
+
+  const int64_t px = ((int64_t)p_Setup.minX << ms_SubPixelBits) + ms_SubPixelHalf;
+  const int64_t py = ((int64_t)p_Setup.minY << ms_SubPixelBits) + ms_SubPixelHalf;
+  int64_t bias[3];
+  for (int i = 0; i < 3; i++)
+  {
+    const int a = (i + 1) % 3;
+    const int b = (i + 2) % 3;
+    const int64_t dx = x[b] - x[a];
+    const int64_t dy = y[b] - y[a];
+
+    // counter clockwise with y up: left edges run downwards, top edges run
+    // to the left. Other edges exclude their samples (edge > 0, i.e. >= 1).
+    const bool topLeft = (dy < 0) || (0 == dy && dx < 0);
+    bias[i] = topLeft ? 0 : -1;
+
+    p_Setup.edge[i] = dx * (py - y[a]) - dy * (px - x[a]) + bias[i];
+    p_Setup.stepX[i] = -dy * ms_SubPixelOne;
+    p_Setup.stepY[i] = dx * ms_SubPixelOne;
+  }
+
+  // z = z0 + w1 / area * (z1 - z0) + w2 / area * (z2 - z0) with the bias
+  // taken out again, turned into a plane at pixel (minX, minY):
+  const double zEdge1 = (double)(z[1] - z[0]) / (double)area;
+  const double zEdge2 = (double)(z[2] - z[0]) / (double)area;
+  p_Setup.zOrigin = (float)(z[0] + (double)(p_Setup.edge[1] - bias[1]) * zEdge1 + (double)(p_Setup.edge[2] - bias[2]) * zEdge2);
+  p_Setup.zStepX = (float)((double)p_Setup.stepX[1] * zEdge1 + (double)p_Setup.stepX[2] * zEdge2);
+  p_Setup.zStepY = (float)((double)p_Setup.stepY[1] * zEdge1 + (double)p_Setup.stepY[2] * zEdge2);
+  return true;
+}
+//---------------------------------------------------------------------------//
+// Instruction set dispatch
+//---------------------------------------------------------------------------//
+#if RASTER_X86
+static void
+cpuid(int p_Leaf, int p_SubLeaf, uint32_t p_Regs[4])
+{
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuidex(regs, p_Leaf, p_SubLeaf);
+  for (int i = 0; i < 4; i++)
+    p_Regs[i] = (uint32_t)regs[i];
+#else
+  __cpuid_count(p_Leaf, p_SubLeaf, p_Regs[0], p_Regs[1], p_Regs[2], p_Regs[3]);
+#endif
+}
+//---------------------------------------------------------------------------//
+// Register state the os saves on context switches (XCR0)
+static uint64_t
+xgetbv0()
+{
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  uint32_t lo, hi;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return ((uint64_t)hi << 32) | lo;
+#endif
+}
+#endif
+//---------------------------------------------------------------------------//
+RasterIsa
+detectRasterIsa()
+{
+#if RASTER_X86
+  uint32_t leaf0[4], leaf1[4], leaf7[4] = {};
+  cpuid(0, 0, leaf0);
+  cpuid(1, 0, leaf1);
+  if (leaf0[0] >= 7)
+    cpuid(7, 0, leaf7);
+
+  const bool sse41 = leaf1[2] & (1u << 19);
+  const bool osxsave = leaf1[2] & (1u << 27);
+  const bool avx = leaf1[2] & (1u << 28);
+  const uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+
+  // ymm state for avx2, opmask and zmm state on top for avx-512:
+  const bool osAvx = 0x6 == (xcr0 & 0x6);
+  const bool osAvx512 = 0xE6 == (xcr0 & 0xE6);
+  const bool avx2 = leaf7[1] & (1u << 5);
+  const bool avx512f = leaf7[1] & (1u << 16);
+
+  if (avx && avx512f && osAvx512)
+    return RasterIsa::Avx512;
+  if (avx && avx2 && osAvx)
+    return RasterIsa::Avx2;
+  if (sse41)
+    return RasterIsa::Sse41;
+#endif
+  return RasterIsa::Scalar;
+}
+//---------------------------------------------------------------------------//
+static const RasterKernels*
+getRasterKernels(RasterIsa p_Isa)
+{
+  switch (p_Isa)
+  {
+  case RasterIsa::Sse41:  return getSse41Kernels();
+  case RasterIsa::Avx2:   return getAvx2Kernels();
+  case RasterIsa::Avx512: return getAvx512Kernels();
+  default:                return nullptr;
+  }
+}
+//---------------------------------------------------------------------------//
+// Kernels of the selected instruction set, nullptr for scalar:
+static RasterIsa g_RasterIsa = detectRasterIsa();
+static const RasterKernels* g_RasterKernels = getRasterKernels(g_RasterIsa);
+//---------------------------------------------------------------------------//
+bool
+setRasterIsa(RasterIsa p_Isa)
+{
+  // instruction sets are ordered, every cpu with one has the ones before:
+  if ((int)p_Isa > (int)detectRasterIsa())
+    return false;
+
+  g_RasterIsa = p_Isa;
+  g_RasterKernels = getRasterKernels(p_Isa);
+  return true;
+}
+//---------------------------------------------------------------------------//
+RasterIsa
+getRasterIsa()
+{
+  return g_RasterIsa;
+}
+//---------------------------------------------------------------------------//
+static const char* ms_RasterIsaNames[] = { "scalar", "sse4.1", "avx2", "avx512" };
+//---------------------------------------------------------------------------//
+const char*
+getRasterIsaName(RasterIsa p_Isa)
+{
+  return ms_RasterIsaNames[(int)p_Isa];
+}
+//---------------------------------------------------------------------------//
+bool
+parseRasterIsa(const char* p_Name, RasterIsa& p_Isa)
+{
+  for (uint32_t i = 0; i < arrayCount32(ms_RasterIsaNames); i++)
+  {
+    if (0 == strcmp(p_Name, ms_RasterIsaNames[i]))
+    {
+      p_Isa = (RasterIsa)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+//---------------------------------------------------------------------------//
+// Triangle rasterization
+//---------------------------------------------------------------------------//
+// Scalar fine rasterization of the pixels [p_X0, p_X1] x [p_Y0, p_Y1],
+// p_Edge holds the edge functions at (p_X0, p_Y0). Full spans skip the
+// coverage test. Handles the spans the 32 bit simd kernels can't.
+template <bool Partial, bool DepthTest>
+static inline void
+rasterizeSpanScalar(
+  Framebuffer& p_Fb, const TriangleSetup& p_Setup, const int64_t p_Edge[3],
+  int p_X0, int p_Y0, int p_X1, int p_Y1, uint32_t p_Color, RasterCounters& p_Counters)
+{
+  StatsRecorder* stats = p_Fb.stats;
+  const int width = p_Fb.width;
+
+  int64_t edgeRow[3] = { p_Edge[0], p_Edge[1], p_Edge[2] };
+  for (int y = p_Y0; y <= p_Y1; y++)
+  {
+    const int colorY = p_Fb.flipVertically ? p_Fb.height - 1 - y : y;
+    uint32_t* colorRow = p_Fb.color + (size_t)colorY * width;
+    const size_t depthRow = (size_t)y * width;
+
+    if constexpr (!Partial && !DepthTest)
+    {
+      // covered and nothing to test, a plain span fill:
+      std::fill(colorRow + p_X0, colorRow + p_X1 + 1, p_Color);
+      p_Counters.covered += p_X1 - p_X0 + 1;
+      if (stats)
+        for (int x = p_X0; x <= p_X1; x++)
+          stats->touchPixel(depthRow + x);
+    }
+    else
+    {
+      const float zRow = p_Setup.zOrigin + (float)(y - p_Setup.originY) * p_Setup.zStepY;
+      int64_t e0 = edgeRow[0];
+      int64_t e1 = edgeRow[1];
+      int64_t e2 = edgeRow[2];
+      for (int x = p_X0; x <= p_X1; x++)
+      {
+        if (!Partial || (e0 | e1 | e2) >= 0)
+        {
+          ++p_Counters.covered;
+          if constexpr (DepthTest)
+          {
+            const float z = zRow + (float)(x - p_Setup.originX) * p_Setup.zStepX;
+            if (p_Fb.depth[depthRow + x] < z) {
+              p_Fb.depth[depthRow + x] = z;
+              colorRow[x] = p_Color;
+              ++p_Counters.depthPassed;
+              if (stats) stats->touchPixel(depthRow + x);
+            }
+            else
+              ++p_Counters.depthFailed;
+          }
+          else
+          {
+            colorRow[x] = p_Color;
+            if (stats) stats->touchPixel(depthRow + x);
+          }
+        }
+        e0 += p_Setup.stepX[0];
+        e1 += p_Setup.stepX[1];
+        e2 += p_Setup.stepX[2];
+      }
+    }
+    edgeRow[0] += p_Setup.stepY[0];
+    edgeRow[1] += p_Setup.stepY[1];
+    edgeRow[2] += p_Setup.stepY[2];
+  }
+}
+//---------------------------------------------------------------------------//
+// Narrows the edge functions of a span to 32 bit. Fails when an edge that
+// crosses the span (or a step) does not fit, e.g. for huge triangles.
+static bool
+makeSpanEdges(
+  const TriangleSetup& p_Setup, const int64_t p_Edge[3],
+  int p_X0, int p_Y0, int p_X1, int p_Y1, SpanEdges& p_Edges)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    const int64_t spanX = (p_X1 - p_X0) * p_Setup.stepX[i];
+    const int64_t spanY = (p_Y1 - p_Y0) * p_Setup.stepY[i];
+    const int64_t lowest = p_Edge[i] + std::min<int64_t>(spanX, 0) + std::min<int64_t>(spanY, 0);
+    const int64_t highest = p_Edge[i] + std::max<int64_t>(spanX, 0) + std::max<int64_t>(spanY, 0);
+    if (lowest >= 0)
+    {
+      // inside over the whole span, always passes:
+      p_Edges.edge[i] = p_Edges.stepX[i] = p_Edges.stepY[i] = 0;
+      continue;
+    }
+
+    auto fits = [](int64_t p_Value) { return p_Value >= INT32_MIN && p_Value <= INT32_MAX; };
+    if (!fits(lowest) || !fits(highest) || !fits(p_Setup.stepX[i]) || !fits(p_Setup.stepY[i]))
+      return false;
+    p_Edges.edge[i] = (int32_t)p_Edge[i];
+    p_Edges.stepX[i] = (int32_t)p_Setup.stepX[i];
+    p_Edges.stepY[i] = (int32_t)p_Setup.stepY[i];
+  }
+  return true;
+}
+//---------------------------------------------------------------------------//
+// Fine rasterization of a run of blocks of the same kind
+template <bool DepthTest>
+static void
+rasterizeSpan(
+  Framebuffer& p_Fb, const TriangleSetup& p_Setup, BlockKind p_Kind,
+  int p_X0, int p_Y0, int p_X1, int p_Y1, uint32_t p_Color, RasterCounters& p_Counters)
+{
+  if (BlockKind::Outside == p_Kind)
+    return;
+
+  int64_t edge[3];
+  for (int i = 0; i < 3; i++)
+    edge[i] = p_Setup.edge[i] + (p_X0 - p_Setup.originX) * p_Setup.stepX[i] + (p_Y0 - p_Setup.originY) * p_Setup.stepY[i];
+
+  const bool partial = BlockKind::Partial == p_Kind;
+  if (!partial && !DepthTest)
+  {
+    // a span fill, already as fast as memory allows:
+    rasterizeSpanScalar<false, false>(p_Fb, p_Setup, edge, p_X0, p_Y0, p_X1, p_Y1, p_Color, p_Counters);
+    return;
+  }
+
+  SpanEdges spanEdges;
+  if (nullptr != g_RasterKernels && makeSpanEdges(p_Setup, edge, p_X0, p_Y0, p_X1, p_Y1, spanEdges))
+  {
+    auto kernel = !partial ? g_RasterKernels->fullDepth
+      : DepthTest ? g_RasterKernels->partialDepth : g_RasterKernels->partialNoDepth;
+    kernel(p_Fb, p_Setup, spanEdges, p_X0, p_Y0, p_X1, p_Y1, p_Color, p_Counters);
+  }
+  else if (partial)
+    rasterizeSpanScalar<true, DepthTest>(p_Fb, p_Setup, edge, p_X0, p_Y0, p_X1, p_Y1, p_Color, p_Counters);
+  else
+    rasterizeSpanScalar<false, DepthTest>(p_Fb, p_Setup, edge, p_X0, p_Y0, p_X1, p_Y1, p_Color, p_Counters);
+}
+//---------------------------------------------------------------------------//
+// Rows: walkBlockRows (Raster_Kernels.hpp), shared with the textured path
+template <bool DepthTest>
+static void
+walkRows(Framebuffer& p_Fb, const TriangleSetup& p_Setup, uint32_t p_Color, RasterCounters& p_Counters)
+{
+  walkBlockRows(p_Setup, p_Counters, [&](BlockKind p_Kind, int p_X0, int p_Y0, int p_X1, int p_Y1) {
+    rasterizeSpan<DepthTest>(p_Fb, p_Setup, p_Kind, p_X0, p_Y0, p_X1, p_Y1, p_Color, p_Counters);
+  });
+}
+//---------------------------------------------------------------------------//
+// Interleaves the bits of p_X and p_Y (Morton code), x in the even bits
+static inline uint32_t
+mortonEncode(uint32_t p_X, uint32_t p_Y)
+{
+  auto spread = [](uint32_t p_V) {
+    p_V &= 0xFFFF;
+    p_V = (p_V | (p_V << 8)) & 0x00FF00FF;
+    p_V = (p_V | (p_V << 4)) & 0x0F0F0F0F;
+    p_V = (p_V | (p_V << 2)) & 0x33333333;
+    p_V = (p_V | (p_V << 1)) & 0x55555555;
+    return p_V;
+  };
+  return spread(p_X) | (spread(p_Y) << 1);
+}
+//---------------------------------------------------------------------------//
+static inline uint32_t
+mortonDecode(uint32_t p_Code)
+{
+  p_Code &= 0x55555555;
+  p_Code = (p_Code | (p_Code >> 1)) & 0x33333333;
+  p_Code = (p_Code | (p_Code >> 2)) & 0x0F0F0F0F;
+  p_Code = (p_Code | (p_Code >> 4)) & 0x00FF00FF;
+  p_Code = (p_Code | (p_Code >> 8)) & 0x0000FFFF;
+  return p_Code;
+}
+//---------------------------------------------------------------------------//
+// Smallest code above p_Code whose block lies in the box of codes p_Min to
+// p_Max, for a p_Code outside it (BIGMIN, Tropf and Herzog): walks the bits
+// from the top and narrows the box along the dimension of each bit.
+static inline uint32_t
+mortonNextInBox(uint32_t p_Code, uint32_t p_Min, uint32_t p_Max)
+{
+  uint32_t next = 0;
+  for (int bit = 31; bit >= 0; bit--)
+  {
+    const uint32_t mask = 1u << bit;
+    const uint32_t below = (0x55555555u << (bit & 1)) & (mask - 1); // lower bits of the same dimension
+    const bool code = 0 != (p_Code & mask);
+    const bool low = 0 != (p_Min & mask);
+    const bool high = 0 != (p_Max & mask);
+    if (!code && !low && high)
+    {
+      // the upper half of the box is a candidate, go on in the lower half:
+      next = (p_Min & ~below) | mask;
+      p_Max = (p_Max & ~mask) | below;
+    }
+    else if (!code && low)
+      return p_Min;
+    else if (code && !high)
+      return next;
+    else if (code && !low)
+      p_Min = (p_Min & ~below) | mask;
+  }
+  return next;
+}
+//---------------------------------------------------------------------------//
+// Tiles: blocks in Z-order, every block on its own. Consecutive blocks stay
+// within a small square of the bounding box instead of a full band.
+template <bool DepthTest>
+static void
+walkTiles(Framebuffer& p_Fb, const TriangleSetup& p_Setup, uint32_t p_Color, RasterCounters& p_Counters)
+{
+  const int firstBlockX = p_Setup.minX - p_Setup.minX % ms_BlockSize;
+  const int firstBlockY = p_Setup.minY - p_Setup.minY % ms_BlockSize;
+  const uint32_t blocksX = (uint32_t)((p_Setup.maxX - firstBlockX) / ms_BlockSize + 1);
+  const uint32_t blocksY = (uint32_t)((p_Setup.maxY - firstBlockY) / ms_BlockSize + 1);
+
+  // codes grow with x and y, so the far corner has the last one. A code that
+  // leaves the bounding box jumps straight to the next one inside it, a wide
+  // or tall box would otherwise step over mostly empty codes:
+  const uint32_t last = mortonEncode(blocksX - 1, blocksY - 1);
+  for (uint32_t code = 0;; code++)
+  {
+    uint32_t bx = mortonDecode(code);
+    uint32_t by = mortonDecode(code >> 1);
+    if (bx >= blocksX || by >= blocksY)
+    {
+      code = mortonNextInBox(code, 0, last);
+      bx = mortonDecode(code);
+      by = mortonDecode(code >> 1);
+    }
+
+    const int blockX = firstBlockX + (int)bx * ms_BlockSize;
+    const int blockY = firstBlockY + (int)by * ms_BlockSize;
+    const int x0 = std::max(blockX, p_Setup.minX);
+    const int y0 = std::max(blockY, p_Setup.minY);
+    const int x1 = std::min(blockX + ms_BlockSize - 1, p_Setup.maxX);
+    const int y1 = std::min(blockY + ms_BlockSize - 1, p_Setup.maxY);
+    rasterizeSpan<DepthTest>(p_Fb, p_Setup, classifyBlock(p_Setup, x0, y0, x1, y1, p_Counters),
+      x0, y0, x1, y1, p_Color, p_Counters);
+    if (last == code)
+      break;
+  }
+}
+//---------------------------------------------------------------------------//
+// Columns: the original x outer, y inner walk over every bounding box pixel,
+// one framebuffer row of stride per step. Only kept as a benchmark reference.
+template <bool DepthTest>
+static void
+walkColumns(Framebuffer& p_Fb, const TriangleSetup& p_Setup, uint32_t p_Color, RasterCounters& p_Counters)
+{
+  int64_t edge[3];
+  for (int i = 0; i < 3; i++)
+    edge[i] = p_Setup.edge[i] + (p_Setup.minX - p_Setup.originX) * p_Setup.stepX[i] + (p_Setup.minY - p_Setup.originY) * p_Setup.stepY[i];
+  for (int x = p_Setup.minX; x <= p_Setup.maxX; x++)
+  {
+    rasterizeSpanScalar<true, DepthTest>(p_Fb, p_Setup, edge, x, p_Setup.minY, x, p_Setup.maxY, p_Color, p_Counters);
+    for (int i = 0; i < 3; i++)
+      edge[i] += p_Setup.stepX[i];
+  }
+}
+//---------------------------------------------------------------------------//
+// Traversal picked with setRasterTraversal:
+static RasterTraversal g_RasterTraversal = RasterTraversal::Rows;
+//---------------------------------------------------------------------------//
+void
+setRasterTraversal(RasterTraversal p_Traversal)
+{
+  g_RasterTraversal = p_Traversal;
+}
+//---------------------------------------------------------------------------//
+RasterTraversal
+getRasterTraversal()
+{
+  return g_RasterTraversal;
+}
+//---------------------------------------------------------------------------//
+static const char* ms_RasterTraversalNames[] = { "rows", "tiles", "columns" };
+//---------------------------------------------------------------------------//
+const char*
+getRasterTraversalName(RasterTraversal p_Traversal)
+{
+  return ms_RasterTraversalNames[(int)p_Traversal];
+}
+//---------------------------------------------------------------------------//
+bool
+parseRasterTraversal(const char* p_Name, RasterTraversal& p_Traversal)
+{
+  for (uint32_t i = 0; i < arrayCount32(ms_RasterTraversalNames); i++)
+  {
+    if (0 == strcmp(p_Name, ms_RasterTraversalNames[i]))
+    {
+      p_Traversal = (RasterTraversal)i;
+      return true;
+    }
+  }
+  return false;
+}
+//---------------------------------------------------------------------------//
+template <bool DepthTest>
+static void
+rasterizeTriangle(Framebuffer& p_Fb, const TriangleSetup& p_Setup, uint32_t p_Color, RasterCounters& p_Counters)
+{
+  // The framebuffer is linear: the row walk writes every touched cache line
+  // of a band in one go and wins for every shape RasterBench has
+  // (traversal/*), Z-order tiles measured 1.5-3.5x and the column walk 7-17x
+  // slower at 4K, large near-square triangles included.
+  switch (g_RasterTraversal)
+  {
+  case RasterTraversal::Tiles:   walkTiles<DepthTest>(p_Fb, p_Setup, p_Color, p_Counters); break;
+  case RasterTraversal::Columns: walkColumns<DepthTest>(p_Fb, p_Setup, p_Color, p_Counters); break;
+  default:                       walkRows<DepthTest>(p_Fb, p_Setup, p_Color, p_Counters); break;
+  }
+}
+//---------------------------------------------------------------------------//
+void
+rasterizeSetup(Framebuffer& p_Fb, const TriangleSetup& p_Setup, uint32_t p_Color, bool p_DepthTest, RasterCounters& p_Counters)
+{
+  if (p_DepthTest)
+    rasterizeTriangle<true>(p_Fb, p_Setup, p_Color, p_Counters);
+  else
+    rasterizeTriangle<false>(p_Fb, p_Setup, p_Color, p_Counters);
+}
+//---------------------------------------------------------------------------//
+void
+addRasterCounters(RasterStats& p_Stats, const RasterCounters& p_Counters, bool p_DepthTest)
+{
+  p_Stats.blocksSkipped += p_Counters.blocksSkipped;
+  p_Stats.blocksFull += p_Counters.blocksFull;
+  p_Stats.blocksPartial += p_Counters.blocksPartial;
+  p_Stats.pixelsCovered += p_Counters.covered;
+  p_Stats.depthTestsPassed += p_Counters.depthPassed;
+  p_Stats.depthTestsFailed += p_Counters.depthFailed;
+  p_Stats.pixelsWritten += p_DepthTest ? p_Counters.depthPassed : p_Counters.covered;
+}
+//---------------------------------------------------------------------------//
+void
+drawTriangle(Framebuffer& p_Fb, const Vec3F p_TriangleVertices[3], uint32_t p_Color, bool p_DepthTest)
+{
+  StatsRecorder* stats = p_Fb.stats;
+  if (!isInsideGuardBand(p_TriangleVertices))
+  {
+    ClippedTriangles clipped;
+    clipToGuardBand(p_TriangleVertices, clipped);
+    if (stats)
+      stats->current.trianglesClipped++;
+    for (int i = 0; i < clipped.count; i++)
+      drawTriangle(p_Fb, clipped.corners[i], p_Color, p_DepthTest);
+    return;
+  }
+
+  TriangleSetup setup;
+  bool degenerate = false;
+  if (!setupTriangle(p_Fb, p_TriangleVertices, setup, degenerate))
+  {
+    if (stats)
+    {
+      stats->current.trianglesRasterized++;
+      stats->current.trianglesDegenerate += degenerate;
+    }
+    return;
+  }
+
+  RasterCounters counters;
+  rasterizeSetup(p_Fb, setup, p_Color, p_DepthTest, counters);
+
+  if (stats)
+  {
+    RasterStats& current = stats->current;
+    current.trianglesRasterized++;
+    current.bboxPixels += (uint64_t)(setup.maxX - setup.minX + 1) * (setup.maxY - setup.minY + 1);
+    addRasterCounters(current, counters, p_DepthTest);
+  }
+}
+//---------------------------------------------------------------------------//
+Vec3F
+worldToScreen (const Framebuffer& p_Fb, Vec3F p_VecWS)
+{
+  // shift and scale x,y from WS [-1, 1] to SS [0, width or height]
+  // keep z-values unchanged, drawTriangle snaps to sub-pixel precision:
+  return Vec3F(
+    (p_VecWS.x + 1.0f) * p_Fb.width / 2.0f,
+    (p_VecWS.y + 1.0f) * p_Fb.height / 2.0f,
+    p_VecWS.z
+  );
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "Math_Types.hpp"
+#include "Colors.hpp"
+#include "Stats.hpp"
+
+class Texture;
+
+// Edge of the square blocks drawTriangle classifies before per-pixel work
+// (cmake -DRASTER_BLOCK_SIZE=<pixels>)
+#ifndef RASTER_BLOCK_SIZE
+#define RASTER_BLOCK_SIZE 8
+#endif
+
+//---------------------------------------------------------------------------//
+// Render target the drawing functions write into. It does not own the memory:
+// the SWC front-end points it at the d3d12 wrapped backbuffer, the headless
+// front-end at plain heap allocations.
+//---------------------------------------------------------------------------//
+struct Framebuffer
+{
+  int width = 0;
+  int height = 0;
+  static constexpr int ms_BytePerPixel = 4;
+
+  uint32_t* color = nullptr; // RGBA8, width * height texels, row-major
+  float* depth = nullptr;    // optional, only needed for depth testing
+
+  // flip y so that y-up model space ends up upright in a top-down buffer
+  bool flipVertically = false;
+
+  // optional, counts what the raster functions do when set
+  StatsRecorder* stats = nullptr;
+};
+
+//---------------------------------------------------------------------------//
+// Culled and lit triangle ready for rasterization
+//---------------------------------------------------------------------------//
+struct ScreenTriangle
+{
+  Vec3F pos[3];
+  uint32_t color;
+};
+//---------------------------------------------------------------------------//
+// Texture coordinates of a ScreenTriangle's corners
+struct TriangleUvs
+{
+  Vec2F uv[3];
+};
+
+//---------------------------------------------------------------------------//
+// Instruction sets of the drawTriangle pixel kernels, picked at startup
+//---------------------------------------------------------------------------//
+enum class RasterIsa
+{
+  Scalar,
+  Sse41,
+  Avx2,
+  Avx512
+};
+//---------------------------------------------------------------------------//
+// Best instruction set this cpu and os support (cpuid and xgetbv)
+RasterIsa
+detectRasterIsa();
+//---------------------------------------------------------------------------//
+// Kernels drawTriangle uses from now on, defaults to detectRasterIsa().
+// Returns false and keeps the current kernels when p_Isa is unsupported.
+bool
+setRasterIsa(RasterIsa p_Isa);
+//---------------------------------------------------------------------------//
+RasterIsa
+getRasterIsa();
+//---------------------------------------------------------------------------//
+const char*
+getRasterIsaName(RasterIsa p_Isa);
+//---------------------------------------------------------------------------//
+// Accepts the names getRasterIsaName returns
+bool
+parseRasterIsa(const char* p_Name, RasterIsa& p_Isa);
+
+//---------------------------------------------------------------------------//
+// Order drawTriangle walks the blocks of a bounding box in. Rows is the
+// default for every triangle: it wins on every shape RasterBench measures
+// (traversal/*), the others are kept for comparison.
+//---------------------------------------------------------------------------//
+enum class RasterTraversal
+{
+  Rows,   // bands of blocks top to bottom, row-major spans inside a band
+  Tiles,  // blocks in Z-order (Morton)
+  Columns // per-pixel x outer, y inner walk, the pre-block order for benchmarks
+};
+//---------------------------------------------------------------------------//
+void
+setRasterTraversal(RasterTraversal p_Traversal);
+//---------------------------------------------------------------------------//
+RasterTraversal
+getRasterTraversal();
+//---------------------------------------------------------------------------//
+const char*
+getRasterTraversalName(RasterTraversal p_Traversal);
+//---------------------------------------------------------------------------//
+// Accepts the names getRasterTraversalName returns
+bool
+parseRasterTraversal(const char* p_Name, RasterTraversal& p_Traversal);
+
+//---------------------------------------------------------------------------//
+// Rendering functions
+//---------------------------------------------------------------------------//
+void
+colorPixel (Framebuffer& p_Fb, int p_X, int p_Y, uint32_t p_Color);
+//---------------------------------------------------------------------------//
+void
+clearBuffer(Framebuffer& p_Fb, uint32_t p_Color);
+//---------------------------------------------------------------------------//
+void
+clearDepthBuffer(Framebuffer& p_Fb);
+//---------------------------------------------------------------------------//
+void
+drawHorizonatalLine(Framebuffer& p_Fb, const int p_LineY);
+//---------------------------------------------------------------------------//
+void
+drawVerticalLine(Framebuffer& p_Fb, const int p_LineX);
+//---------------------------------------------------------------------------//
+void
+drawLineSimple(Framebuffer& p_Fb, int p_X0, int p_Y0, int p_X1, int p_Y1, uint32_t p_Color);
+//---------------------------------------------------------------------------//
+Vec3F
+barycentric(const Vec3F p_TriangleVertices[3], Vec3F p_Point);
+//---------------------------------------------------------------------------//
+// Corners more than 2^24 pixels out (the guard band of the fixed point
+// setup) are clipped first, the parts are drawn as triangles of their own
+// and RasterStats::trianglesClipped counts the clipped triangle.
+void
+drawTriangle(Framebuffer& p_Fb, const Vec3F p_TriangleVertices[3], uint32_t p_Color, bool p_DepthTest);
+//---------------------------------------------------------------------------//
+// Same pixels and stats as calling drawTriangle for each triangle in order.
+// With more than one JobSystem thread the triangles are binned into screen
+// tiles that the workers rasterize in parallel (Raster_Tiles.cpp).
+void
+drawTriangles(Framebuffer& p_Fb, const ScreenTriangle* p_Triangles, size_t p_Count, bool p_DepthTest);
+//---------------------------------------------------------------------------//
+// drawTriangle with p_Texture sampled bilinearly across the triangle and
+// multiplied by p_Color per channel. The coordinates are interpolated
+// linearly in screen space, exact for the orthographic Camera.
+void
+drawTriangleTextured(Framebuffer& p_Fb, const Vec3F p_TriangleVertices[3], const Vec2F p_Uvs[3], uint32_t p_Color,
+  const Texture& p_Texture, bool p_DepthTest);
+//---------------------------------------------------------------------------//
+// drawTriangles for drawTriangleTextured, p_Uvs runs parallel to p_Triangles
+void
+drawTrianglesTextured(Framebuffer& p_Fb, const ScreenTriangle* p_Triangles, const TriangleUvs* p_Uvs, size_t p_Count,
+  const Texture& p_Texture, bool p_DepthTest);
+//---------------------------------------------------------------------------//
+Vec3F
+worldToScreen (const Framebuffer& p_Fb, Vec3F p_VecWS);
@@ -0,0 +1,77 @@
+// Raster_Avx2.cpp : drawTriangle pixel kernels, 8 pixels per step.
+// Description: the kernels use AVX2, only called after the cpuid check
+//
+
+#include "Raster_Kernels.hpp"
+
+#include <bit>
+
+#if RASTER_X86
+#include <immintrin.h>
+
+RASTER_TARGET_BEGIN("avx2")
+#include "Raster_Simd.hpp"
+
+//---------------------------------------------------------------------------//
+// Masks are full lanes, vpmaskmov keeps the loads and stores inside the span
+//---------------------------------------------------------------------------//
+namespace {
+struct Avx2
+{
+  using Int = __m256i;
+  using Float = __m256;
+  using Mask = __m256i;
+  static constexpr int ms_Lanes = 8;
+
+  static Int set(int32_t p_Value) { return _mm256_set1_epi32(p_Value); }
+  static Float setF(float p_Value) { return _mm256_set1_ps(p_Value); }
+  static Int laneIndex() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+  static Int add(Int p_A, Int p_B) { return _mm256_add_epi32(p_A, p_B); }
+  static Int mul(Int p_A, Int p_B) { return _mm256_mullo_epi32(p_A, p_B); }
+  static Int orInt(Int p_A, Int p_B) { return _mm256_or_si256(p_A, p_B); }
+  static Float toFloat(Int p_A) { return _mm256_cvtepi32_ps(p_A); }
+  static Float addF(Float p_A, Float p_B) { return _mm256_add_ps(p_A, p_B); }
+  static Float mulF(Float p_A, Float p_B) { return _mm256_mul_ps(p_A, p_B); }
+
+  static Mask nonNegative(Int p_A) { return _mm256_cmpgt_epi32(p_A, _mm256_set1_epi32(-1)); }
+  static Mask lanesBelow(int p_Count) { return _mm256_cmpgt_epi32(_mm256_set1_epi32(p_Count), laneIndex()); }
+  static Mask less(Float p_A, Float p_B) { return _mm256_castps_si256(_mm256_cmp_ps(p_A, p_B, _CMP_LT_OQ)); }
+  static Mask andMask(Mask p_A, Mask p_B) { return _mm256_and_si256(p_A, p_B); }
+  static uint32_t bits(Mask p_A) { return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(p_A)); }
+
+  static Float
+  loadDepth(const float* p_Src, Mask p_InSpan)
+  {
+    return _mm256_maskload_ps(p_Src, p_InSpan);
+  }
+  static void
+  storeDepth(float* p_Dst, Float p_Value, Mask p_Mask, Mask)
+  {
+    _mm256_maskstore_ps(p_Dst, p_Mask, p_Value);
+  }
+  static void
+  storeColor(uint32_t* p_Dst, uint32_t p_Color, Mask p_Mask, Mask)
+  {
+    _mm256_maskstore_epi32((int*)p_Dst, p_Mask, _mm256_set1_epi32((int)p_Color));
+  }
+};
+} // namespace
+
+//---------------------------------------------------------------------------//
+static constexpr RasterKernels ms_Avx2Kernels = makeSimdKernels<Avx2>();
+RASTER_TARGET_END
+
+//---------------------------------------------------------------------------//
+const RasterKernels*
+getAvx2Kernels()
+{
+  return &ms_Avx2Kernels;
+}
+#else
+//---------------------------------------------------------------------------//
+const RasterKernels*
+getAvx2Kernels()
+{
+  return nullptr;
+}
+#endif
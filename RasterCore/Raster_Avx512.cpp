@@ -0,0 +1,78 @@
+// Raster_Avx512.cpp : drawTriangle pixel kernels, 16 pixels per step.
+// Description: the kernels use AVX-512F, only called after the cpuid check
+//
+
+#include "Raster_Kernels.hpp"
+
+#include <bit>
+
+#if RASTER_X86
+#include <immintrin.h>
+
+RASTER_TARGET_BEGIN("avx512f")
+#include "Raster_Simd.hpp"
+
+//---------------------------------------------------------------------------//
+// Masks live in the k registers, loads and stores are natively masked
+//---------------------------------------------------------------------------//
+namespace {
+struct Avx512
+{
+  using Int = __m512i;
+  using Float = __m512;
+  using Mask = __mmask16;
+  static constexpr int ms_Lanes = 16;
+
+  static Int set(int32_t p_Value) { return _mm512_set1_epi32(p_Value); }
+  static Float setF(float p_Value) { return _mm512_set1_ps(p_Value); }
+  static Int laneIndex() { return _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15); }
+  static Int add(Int p_A, Int p_B) { return _mm512_add_epi32(p_A, p_B); }
+  static Int mul(Int p_A, Int p_B) { return _mm512_mullo_epi32(p_A, p_B); }
+  static Int orInt(Int p_A, Int p_B) { return _mm512_or_si512(p_A, p_B); }
+  // same vcvtdq2ps, the unmasked intrinsic trips -Wmaybe-uninitialized on gcc 12:
+  static Float toFloat(Int p_A) { return _mm512_maskz_cvtepi32_ps((__mmask16)0xFFFF, p_A); }
+  static Float addF(Float p_A, Float p_B) { return _mm512_add_ps(p_A, p_B); }
+  static Float mulF(Float p_A, Float p_B) { return _mm512_mul_ps(p_A, p_B); }
+
+  static Mask nonNegative(Int p_A) { return _mm512_cmpgt_epi32_mask(p_A, _mm512_set1_epi32(-1)); }
+  static Mask lanesBelow(int p_Count) { return p_Count >= ms_Lanes ? (Mask)0xFFFF : (Mask)((1u << p_Count) - 1); }
+  static Mask less(Float p_A, Float p_B) { return _mm512_cmp_ps_mask(p_A, p_B, _CMP_LT_OQ); }
+  static Mask andMask(Mask p_A, Mask p_B) { return (Mask)(p_A & p_B); }
+  static uint32_t bits(Mask p_A) { return (uint32_t)p_A; }
+
+  static Float
+  loadDepth(const float* p_Src, Mask p_InSpan)
+  {
+    return _mm512_maskz_loadu_ps(p_InSpan, p_Src);
+  }
+  static void
+  storeDepth(float* p_Dst, Float p_Value, Mask p_Mask, Mask)
+  {
+    _mm512_mask_storeu_ps(p_Dst, p_Mask, p_Value);
+  }
+  static void
+  storeColor(uint32_t* p_Dst, uint32_t p_Color, Mask p_Mask, Mask)
+  {
+    _mm512_mask_storeu_epi32(p_Dst, p_Mask, _mm512_set1_epi32((int)p_Color));
+  }
+};
+} // namespace
+
+//---------------------------------------------------------------------------//
+static constexpr RasterKernels ms_Avx512Kernels = makeSimdKernels<Avx512>();
+RASTER_TARGET_END
+
+//---------------------------------------------------------------------------//
+const RasterKernels*
+getAvx512Kernels()
+{
+  return &ms_Avx512Kernels;
+}
+#else
+//---------------------------------------------------------------------------//
+const RasterKernels*
+getAvx512Kernels()
+{
+  return nullptr;
+}
+#endif
@@ -0,0 +1,253 @@
+#pragma once
+
+// Internal to drawTriangle: triangle setup shared between Raster.cpp and the
+// per-ISA pixel kernels (Raster_Sse41.cpp, Raster_Avx2.cpp, Raster_Avx512.cpp)
+
+#include "Raster.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RASTER_X86 1
+#else
+#define RASTER_X86 0
+#endif
+
+// The per-ISA units build their kernels between RASTER_TARGET_BEGIN and
+// RASTER_TARGET_END instead of with per-file -m flags. Headers shared with
+// the rest of the library are included before the region, so their inline
+// functions are compiled for the baseline cpu in every unit and the linker
+// can't keep an AVX copy for a scalar caller. MSVC accepts the intrinsics
+// without /arch.
+#define RASTER_PRAGMA(p_Text) _Pragma(#p_Text)
+#if defined(__clang__)
+#define RASTER_TARGET_BEGIN(p_Target) \
+  RASTER_PRAGMA(clang attribute push(__attribute__((target(p_Target))), apply_to = function))
+#define RASTER_TARGET_END RASTER_PRAGMA(clang attribute pop)
+#elif defined(__GNUC__)
+#define RASTER_TARGET_BEGIN(p_Target) RASTER_PRAGMA(GCC push_options) RASTER_PRAGMA(GCC target(p_Target))
+#define RASTER_TARGET_END RASTER_PRAGMA(GCC pop_options)
+#else
+#define RASTER_TARGET_BEGIN(p_Target)
+#define RASTER_TARGET_END
+#endif
+
+//---------------------------------------------------------------------------//
+// Triangle setup
+//---------------------------------------------------------------------------//
+// Vertices are snapped to 28.4 fixed point and pixels are sampled at their
+// centers. The edge functions are exact integers:
+//   edge(a, b, p) = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x)
+// edge[0] runs v1->v2 (weight of v0), edge[1] v2->v0 and edge[2] v0->v1.
+//
+// Fill rule: a sample exactly on an edge belongs to the triangle only when
+// the edge is a top or left edge, so pixels on an edge shared by two
+// triangles are written exactly once.
+struct TriangleSetup
+{
+  // pixels to walk: the bounding box clamped to the framebuffer, the tile
+  // renderer clamps it further to a tile
+  int minX, minY, maxX, maxY;
+
+  // pixel the edge functions and the depth plane are anchored at, the
+  // clamped bounding box corner. It stays put when the box is clamped to a
+  // tile, so tiled and untiled rendering compute the same values.
+  int originX, originY;
+
+  // edge functions at the center of pixel (originX, originY), fill rule bias
+  // included so that a pixel is covered when all three are >= 0
+  int64_t edge[3];
+  int64_t stepX[3];
+  int64_t stepY[3];
+
+  // every kernel evaluates the depth plane as
+  //   zRow = zOrigin + (float)(y - originY) * zStepY
+  //   z    = zRow + (float)(x - originX) * zStepX
+  // so the scalar and simd paths produce bit identical depth values
+  float zOrigin;
+  float zStepX;
+  float zStepY;
+};
+//---------------------------------------------------------------------------//
+// Counted locally and flushed once per triangle, keeps the pixel loops free
+// of stores to the recorder
+struct RasterCounters
+{
+  uint64_t covered = 0;
+  uint64_t depthPassed = 0;
+  uint64_t depthFailed = 0;
+  uint64_t blocksSkipped = 0;
+  uint64_t blocksFull = 0;
+  uint64_t blocksPartial = 0;
+};
+//---------------------------------------------------------------------------//
+// Edge functions of one span of blocks, small enough for 32 bit lanes. Edges
+// that are non-negative over the whole span are replaced by 0 with 0 steps.
+struct SpanEdges
+{
+  int32_t edge[3]; // at the first pixel of the span
+  int32_t stepX[3];
+  int32_t stepY[3];
+};
+
+//---------------------------------------------------------------------------//
+// Block traversal
+//---------------------------------------------------------------------------//
+static constexpr int ms_BlockSize = RASTER_BLOCK_SIZE;
+static_assert(ms_BlockSize > 0, "RASTER_BLOCK_SIZE has to be positive");
+//---------------------------------------------------------------------------//
+enum class BlockKind
+{
+  Outside,
+  Inside,
+  Partial
+};
+//---------------------------------------------------------------------------//
+// Edge functions are linear, so their extremes over a block are at its
+// corners: a block with an edge negative at every corner is outside, a block
+// with all edges non-negative at every corner is inside.
+inline BlockKind
+classifyBlock(const TriangleSetup& p_Setup, int p_X0, int p_Y0, int p_X1, int p_Y1, RasterCounters& p_Counters)
+{
+  bool outside = false;
+  bool inside = true;
+  for (int i = 0; i < 3; i++)
+  {
+    const int64_t edge = p_Setup.edge[i] + (p_X0 - p_Setup.originX) * p_Setup.stepX[i] + (p_Y0 - p_Setup.originY) * p_Setup.stepY[i];
+    const int64_t spanX = (p_X1 - p_X0) * p_Setup.stepX[i];
+    const int64_t spanY = (p_Y1 - p_Y0) * p_Setup.stepY[i];
+    const int64_t lowest = edge + std::min<int64_t>(spanX, 0) + std::min<int64_t>(spanY, 0);
+    const int64_t highest = edge + std::max<int64_t>(spanX, 0) + std::max<int64_t>(spanY, 0);
+    outside |= highest < 0;
+    inside &= lowest >= 0;
+  }
+
+  if (outside)
+  {
+    ++p_Counters.blocksSkipped;
+    return BlockKind::Outside;
+  }
+  if (inside)
+  {
+    ++p_Counters.blocksFull;
+    return BlockKind::Inside;
+  }
+  ++p_Counters.blocksPartial;
+  return BlockKind::Partial;
+}
+//---------------------------------------------------------------------------//
+// One band of blocks after the other, top to bottom. Neighbouring blocks of
+// the same kind are handed to p_Span(kind, x0, y0, x1, y1) as one span, so
+// every pixel row of the band is written left to right in one go and the
+// wide simd kernels see more than one block at a time. Spans outside the
+// triangle are skipped.
+template <class SpanFn>
+inline void
+walkBlockRows(const TriangleSetup& p_Setup, RasterCounters& p_Counters, SpanFn&& p_Span)
+{
+  const int firstBlockX = p_Setup.minX - p_Setup.minX % ms_BlockSize;
+  const int firstBlockY = p_Setup.minY - p_Setup.minY % ms_BlockSize;
+  for (int blockY = firstBlockY; blockY <= p_Setup.maxY; blockY += ms_BlockSize)
+  {
+    const int y0 = std::max(blockY, p_Setup.minY);
+    const int y1 = std::min(blockY + ms_BlockSize - 1, p_Setup.maxY);
+
+    BlockKind spanKind = BlockKind::Outside;
+    int spanX0 = p_Setup.minX;
+    int spanX1 = p_Setup.minX;
+    for (int blockX = firstBlockX; blockX <= p_Setup.maxX; blockX += ms_BlockSize)
+    {
+      const int x0 = std::max(blockX, p_Setup.minX);
+      const int x1 = std::min(blockX + ms_BlockSize - 1, p_Setup.maxX);
+
+      const BlockKind kind = classifyBlock(p_Setup, x0, y0, x1, y1, p_Counters);
+      if (kind != spanKind)
+      {
+        if (BlockKind::Outside != spanKind)
+          p_Span(spanKind, spanX0, y0, spanX1, y1);
+        spanKind = kind;
+        spanX0 = x0;
+      }
+      spanX1 = x1;
+    }
+    if (BlockKind::Outside != spanKind)
+      p_Span(spanKind, spanX0, y0, spanX1, y1);
+  }
+}
+
+//---------------------------------------------------------------------------//
+// Triangle functions
+//---------------------------------------------------------------------------//
+// Corners setupTriangle can snap without overflowing its 28.4 edge functions
+bool
+isInsideGuardBand(const Vec3F p_TriangleVertices[3]);
+//---------------------------------------------------------------------------//
+// Part of a triangle inside the guard band, a fan of up to 5 triangles
+struct ClippedTriangles
+{
+  Vec3F corners[5][3];
+  int count = 0;
+};
+//---------------------------------------------------------------------------//
+// For triangles isInsideGuardBand rejects, depth is interpolated along the
+// clipped edges. Empty when a corner is not finite.
+void
+clipToGuardBand(const Vec3F p_TriangleVertices[3], ClippedTriangles& p_Clipped);
+//---------------------------------------------------------------------------//
+// Returns false for triangles that cover no pixel: zero area, outside the
+// framebuffer or outside the guard band (clip those to it first).
+// p_Degenerate tells the first case.
+bool
+setupTriangle(const Framebuffer& p_Fb, const Vec3F p_TriangleVertices[3], TriangleSetup& p_Setup, bool& p_Degenerate);
+//---------------------------------------------------------------------------//
+// Walks the pixels [minX, maxX] x [minY, maxY] of p_Setup
+void
+rasterizeSetup(Framebuffer& p_Fb, const TriangleSetup& p_Setup, uint32_t p_Color, bool p_DepthTest, RasterCounters& p_Counters);
+//---------------------------------------------------------------------------//
+// Texture coordinate planes of a textured triangle, evaluated like the depth
+// plane: uRow = uOrigin + (float)(y - originY) * uStepY and so on
+struct UvPlanes
+{
+  float uOrigin, uStepX, uStepY;
+  float vOrigin, vStepX, vStepY;
+};
+//---------------------------------------------------------------------------//
+// Planes through the corners of a triangle that setupTriangle accepted
+UvPlanes
+setupUvPlanes(const TriangleSetup& p_Setup, const Vec3F p_TriangleVertices[3], const Vec2F p_Uvs[3]);
+//---------------------------------------------------------------------------//
+// rasterizeSetup sampling p_Texture (Raster_Textured.cpp)
+void
+rasterizeSetupTextured(Framebuffer& p_Fb, const TriangleSetup& p_Setup, const UvPlanes& p_Planes, uint32_t p_Color,
+  const Texture& p_Texture, bool p_DepthTest, RasterCounters& p_Counters);
+//---------------------------------------------------------------------------//
+// Adds everything but the per-triangle counts (triangles, bounding box)
+void
+addRasterCounters(RasterStats& p_Stats, const RasterCounters& p_Counters, bool p_DepthTest);
+
+//---------------------------------------------------------------------------//
+// Pixel kernels of one instruction set. They rasterize the pixels
+// [p_X0, p_X1] x [p_Y0, p_Y1] of a span of blocks.
+//---------------------------------------------------------------------------//
+struct RasterKernels
+{
+  // blocks crossing an edge: coverage test per pixel
+  void (*partialDepth)(Framebuffer& p_Fb, const TriangleSetup& p_Setup, const SpanEdges& p_Edges,
+    int p_X0, int p_Y0, int p_X1, int p_Y1, uint32_t p_Color, RasterCounters& p_Counters);
+  void (*partialNoDepth)(Framebuffer& p_Fb, const TriangleSetup& p_Setup, const SpanEdges& p_Edges,
+    int p_X0, int p_Y0, int p_X1, int p_Y1, uint32_t p_Color, RasterCounters& p_Counters);
+
+  // blocks inside the triangle, only the depth test is left
+  void (*fullDepth)(Framebuffer& p_Fb, const TriangleSetup& p_Setup, const SpanEdges& p_Edges,
+    int p_X0, int p_Y0, int p_X1, int p_Y1, uint32_t p_Color, RasterCounters& p_Counters);
+};
+//---------------------------------------------------------------------------//
+// nullptr when the build target has no such instruction set (non x86)
+const RasterKernels*
+getSse41Kernels();
+//---------------------------------------------------------------------------//
+const RasterKernels*
+getAvx2Kernels();
+//---------------------------------------------------------------------------//
+const RasterKernels*
+getAvx512Kernels();
@@ -0,0 +1,109 @@
+#pragma once
+
+// Pixel kernels written once against a small simd interface, included by the
+// per-ISA translation units inside their RASTER_TARGET_BEGIN region. The
+// functions have internal linkage: every unit compiles its own copy for its
+// own instruction set. Raster_Kernels.hpp and <bit> are included by the unit
+// before the region, this header includes nothing itself.
+//
+// The Simd interface (see Raster_Sse41.cpp for the smallest one):
+//   Int, Float, Mask, ms_Lanes
+//   set, setF, laneIndex, add, mul, orInt, toFloat, addF, mulF
+//   nonNegative(Int), lanesBelow(count), less(Float, Float), andMask, bits
+//   loadDepth(ptr, inSpan), storeDepth(ptr, value, mask, inSpan),
+//   storeColor(ptr, color, mask, inSpan)
+// Lanes outside inSpan are never read or written.
+
+//---------------------------------------------------------------------------//
+template <class Simd, bool Partial, bool DepthTest>
+static void
+rasterizeSpanSimd(
+  Framebuffer& p_Fb, const TriangleSetup& p_Setup, const SpanEdges& p_Edges,
+  int p_X0, int p_Y0, int p_X1, int p_Y1, uint32_t p_Color, RasterCounters& p_Counters)
+{
+  using Int = typename Simd::Int;
+  using Float = typename Simd::Float;
+  using Mask = typename Simd::Mask;
+  constexpr int lanes = Simd::ms_Lanes;
+
+  StatsRecorder* stats = p_Fb.stats;
+  const int width = p_Fb.width;
+  const Int laneIndex = Simd::laneIndex();
+  const Int laneCount = Simd::set(lanes);
+  const Float zStepX = Simd::setF(p_Setup.zStepX);
+
+  // edge increments across the lanes and from one group of lanes to the
+  // next, wrapping around in 32 bit only ever hits lanes past the span:
+  Int laneStep[3];
+  Int groupStep[3];
+  for (int i = 0; i < 3; i++)
+  {
+    laneStep[i] = Simd::mul(laneIndex, Simd::set(p_Edges.stepX[i]));
+    groupStep[i] = Simd::set((int32_t)((uint32_t)p_Edges.stepX[i] * (uint32_t)lanes));
+  }
+
+  for (int y = p_Y0; y <= p_Y1; y++)
+  {
+    const int colorY = p_Fb.flipVertically ? p_Fb.height - 1 - y : y;
+    uint32_t* colorRow = p_Fb.color + (size_t)colorY * width;
+    float* depthRow = DepthTest ? p_Fb.depth + (size_t)y * width : nullptr;
+    const size_t pixelRow = (size_t)y * width;
+
+    Int edge[3];
+    for (int i = 0; i < 3; i++)
+    {
+      const int32_t rowEdge = (int32_t)(p_Edges.edge[i] + (int64_t)(y - p_Y0) * p_Edges.stepY[i]);
+      edge[i] = Simd::add(Simd::set(rowEdge), laneStep[i]);
+    }
+    const Float zRow = Simd::setF(p_Setup.zOrigin + (float)(y - p_Setup.originY) * p_Setup.zStepY);
+    Int laneX = Simd::add(Simd::set(p_X0 - p_Setup.originX), laneIndex);
+
+    for (int x = p_X0; x <= p_X1; x += lanes)
+    {
+      const Mask inSpan = Simd::lanesBelow(p_X1 - x + 1);
+      Mask covered = inSpan;
+      if constexpr (Partial)
+        covered = Simd::andMask(covered, Simd::nonNegative(Simd::orInt(Simd::orInt(edge[0], edge[1]), edge[2])));
+
+      const uint32_t coveredBits = Simd::bits(covered);
+      if (0 != coveredBits)
+      {
+        uint32_t writtenBits = coveredBits;
+        if constexpr (DepthTest)
+        {
+          const Float z = Simd::addF(zRow, Simd::mulF(Simd::toFloat(laneX), zStepX));
+          const Float old = Simd::loadDepth(depthRow + x, inSpan);
+          const Mask passed = Simd::andMask(covered, Simd::less(old, z));
+          Simd::storeDepth(depthRow + x, z, passed, inSpan);
+          Simd::storeColor(colorRow + x, p_Color, passed, inSpan);
+
+          writtenBits = Simd::bits(passed);
+          p_Counters.depthPassed += std::popcount(writtenBits);
+          p_Counters.depthFailed += std::popcount(coveredBits & ~writtenBits);
+        }
+        else
+          Simd::storeColor(colorRow + x, p_Color, covered, inSpan);
+        p_Counters.covered += std::popcount(coveredBits);
+
+        if (stats)
+          for (uint32_t bits = writtenBits; 0 != bits; bits &= bits - 1)
+            stats->touchPixel(pixelRow + x + std::countr_zero(bits));
+      }
+
+      for (int i = 0; i < 3; i++)
+        edge[i] = Simd::add(edge[i], groupStep[i]);
+      laneX = Simd::add(laneX, laneCount);
+    }
+  }
+}
+//---------------------------------------------------------------------------//
+template <class Simd>
+static constexpr RasterKernels
+makeSimdKernels()
+{
+  RasterKernels kernels = {};
+  kernels.partialDepth = &rasterizeSpanSimd<Simd, true, true>;
+  kernels.partialNoDepth = &rasterizeSpanSimd<Simd, true, false>;
+  kernels.fullDepth = &rasterizeSpanSimd<Simd, false, true>;
+  return kernels;
+}
@@ -0,0 +1,102 @@
+// Raster_Sse41.cpp : drawTriangle pixel kernels, 4 pixels per step.
+// Description: the kernels use SSE4.1, only called after the cpuid check
+//
+
+#include "Raster_Kernels.hpp"
+
+#include <bit>
+
+#if RASTER_X86
+#include <smmintrin.h>
+
+RASTER_TARGET_BEGIN("sse4.1")
+#include "Raster_Simd.hpp"
+
+//---------------------------------------------------------------------------//
+// SSE4.1 has no masked loads and stores: full groups blend against the
+// buffer contents, the last group of a span goes through the stack
+//---------------------------------------------------------------------------//
+namespace {
+struct Sse41
+{
+  using Int = __m128i;
+  using Float = __m128;
+  using Mask = __m128i;
+  static constexpr int ms_Lanes = 4;
+  static constexpr uint32_t ms_AllLanes = 0xF;
+
+  static Int set(int32_t p_Value) { return _mm_set1_epi32(p_Value); }
+  static Float setF(float p_Value) { return _mm_set1_ps(p_Value); }
+  static Int laneIndex() { return _mm_setr_epi32(0, 1, 2, 3); }
+  static Int add(Int p_A, Int p_B) { return _mm_add_epi32(p_A, p_B); }
+  static Int mul(Int p_A, Int p_B) { return _mm_mullo_epi32(p_A, p_B); }
+  static Int orInt(Int p_A, Int p_B) { return _mm_or_si128(p_A, p_B); }
+  static Float toFloat(Int p_A) { return _mm_cvtepi32_ps(p_A); }
+  static Float addF(Float p_A, Float p_B) { return _mm_add_ps(p_A, p_B); }
+  static Float mulF(Float p_A, Float p_B) { return _mm_mul_ps(p_A, p_B); }
+
+  static Mask nonNegative(Int p_A) { return _mm_cmpgt_epi32(p_A, _mm_set1_epi32(-1)); }
+  static Mask lanesBelow(int p_Count) { return _mm_cmpgt_epi32(_mm_set1_epi32(p_Count), laneIndex()); }
+  static Mask less(Float p_A, Float p_B) { return _mm_castps_si128(_mm_cmplt_ps(p_A, p_B)); }
+  static Mask andMask(Mask p_A, Mask p_B) { return _mm_and_si128(p_A, p_B); }
+  static uint32_t bits(Mask p_A) { return (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(p_A)); }
+
+  static Float
+  loadDepth(const float* p_Src, Mask p_InSpan)
+  {
+    if (ms_AllLanes == bits(p_InSpan))
+      return _mm_loadu_ps(p_Src);
+
+    alignas(16) float lanes[ms_Lanes] = {};
+    for (uint32_t inSpan = bits(p_InSpan); 0 != inSpan; inSpan &= inSpan - 1)
+      lanes[std::countr_zero(inSpan)] = p_Src[std::countr_zero(inSpan)];
+    return _mm_load_ps(lanes);
+  }
+  static void
+  storeDepth(float* p_Dst, Float p_Value, Mask p_Mask, Mask p_InSpan)
+  {
+    if (ms_AllLanes == bits(p_InSpan))
+    {
+      _mm_storeu_ps(p_Dst, _mm_blendv_ps(_mm_loadu_ps(p_Dst), p_Value, _mm_castsi128_ps(p_Mask)));
+      return;
+    }
+
+    alignas(16) float lanes[ms_Lanes];
+    _mm_store_ps(lanes, p_Value);
+    for (uint32_t mask = bits(p_Mask); 0 != mask; mask &= mask - 1)
+      p_Dst[std::countr_zero(mask)] = lanes[std::countr_zero(mask)];
+  }
+  static void
+  storeColor(uint32_t* p_Dst, uint32_t p_Color, Mask p_Mask, Mask p_InSpan)
+  {
+    if (ms_AllLanes == bits(p_InSpan))
+    {
+      __m128i* dst = (__m128i*)p_Dst;
+      _mm_storeu_si128(dst, _mm_blendv_epi8(_mm_loadu_si128(dst), _mm_set1_epi32((int)p_Color), p_Mask));
+      return;
+    }
+
+    for (uint32_t mask = bits(p_Mask); 0 != mask; mask &= mask - 1)
+      p_Dst[std::countr_zero(mask)] = p_Color;
+  }
+};
+} // namespace
+
+//---------------------------------------------------------------------------//
+static constexpr RasterKernels ms_Sse41Kernels = makeSimdKernels<Sse41>();
+RASTER_TARGET_END
+
+//---------------------------------------------------------------------------//
+const RasterKernels*
+getSse41Kernels()
+{
+  return &ms_Sse41Kernels;
+}
+#else
+//---------------------------------------------------------------------------//
+const RasterKernels*
+getSse41Kernels()
+{
+  return nullptr;
+}
+#endif
@@ -0,0 +1,236 @@
+// Raster_Textured.cpp : textured triangle rasterization.
+// Description: the edge functions and the depth plane of drawTriangle plus
+// two texture coordinate planes. Pixels that pass the depth test are queued
+// and sampled in batches through the batched Texture samplers.
+//
+
+#include "Raster.hpp"
+#include "Raster_Kernels.hpp"
+#include "Texture.hpp"
+
+//---------------------------------------------------------------------------//
+// Texture coordinates
+//---------------------------------------------------------------------------//
+UvPlanes
+setupUvPlanes(const TriangleSetup& p_Setup, const Vec3F p_TriangleVertices[3], const Vec2F p_Uvs[3])
+{
+  // gradients from the unsnapped corners, a 1/16 pixel snap does not move a
+  // texel noticeably and the corners keep their order:
+  const double x0 = p_TriangleVertices[0].x, y0 = p_TriangleVertices[0].y;
+  const double dx1 = p_TriangleVertices[1].x - x0, dy1 = p_TriangleVertices[1].y - y0;
+  const double dx2 = p_TriangleVertices[2].x - x0, dy2 = p_TriangleVertices[2].y - y0;
+  const double area = dx1 * dy2 - dx2 * dy1;
+
+  // pixel centers are at +0.5, the planes start at the origin pixel:
+  const double px = p_Setup.originX + 0.5 - x0;
+  const double py = p_Setup.originY + 0.5 - y0;
+  auto plane = [&](double p_A0, double p_A1, double p_A2, float& p_Origin, float& p_StepX, float& p_StepY) {
+    const double da1 = p_A1 - p_A0;
+    const double da2 = p_A2 - p_A0;
+    const double stepX = 0.0 != area ? (da1 * dy2 - da2 * dy1) / area : 0.0;
+    const double stepY = 0.0 != area ? (da2 * dx1 - da1 * dx2) / area : 0.0;
+    p_Origin = (float)(p_A0 + px * stepX + py * stepY);
+    p_StepX = (float)stepX;
+    p_StepY = (float)stepY;
+  };
+
+  UvPlanes planes;
+  plane(p_Uvs[0].u, p_Uvs[1].u, p_Uvs[2].u, planes.uOrigin, planes.uStepX, planes.uStepY);
+  plane(p_Uvs[0].v, p_Uvs[1].v, p_Uvs[2].v, planes.vOrigin, planes.vStepX, planes.vStepY);
+  return planes;
+}
+
+//---------------------------------------------------------------------------//
+// Pixel loop
+//---------------------------------------------------------------------------//
+// Pixels sampled per call of the batched sampler, a multiple of the widest
+// kernel so only a triangle's last batch has a scalar tail
+static constexpr uint32_t ms_SampleBatch = 64;
+//---------------------------------------------------------------------------//
+struct SampleBatch
+{
+  float u[ms_SampleBatch];
+  float v[ms_SampleBatch];
+  uint32_t* color[ms_SampleBatch];
+  uint32_t texels[ms_SampleBatch];
+  uint32_t count = 0;
+};
+//---------------------------------------------------------------------------//
+// (texel * (color + 1)) >> 8 per channel, a white triangle keeps the texel
+static inline uint32_t
+modulateTexel(uint32_t p_Texel, uint32_t p_Color)
+{
+  uint32_t result = 0;
+  for (int shift = 0; shift < 32; shift += 8)
+  {
+    const uint32_t channel = ((p_Texel >> shift) & 0xFF) * (((p_Color >> shift) & 0xFF) + 1) >> 8;
+    result |= channel << shift;
+  }
+  return result;
+}
+//---------------------------------------------------------------------------//
+static void
+flushSamples(SampleBatch& p_Batch, const Texture& p_Texture, uint32_t p_Color)
+{
+  p_Texture.sampleBilinear(p_Batch.u, p_Batch.v, p_Batch.count, p_Batch.texels);
+  for (uint32_t i = 0; i < p_Batch.count; i++)
+    *p_Batch.color[i] = modulateTexel(p_Batch.texels[i], p_Color);
+  p_Batch.count = 0;
+}
+//---------------------------------------------------------------------------//
+// One span of blocks of the same kind: Partial spans test every pixel against
+// the edges, inside ones are covered. Depth and coverage are decided per
+// pixel right away, the color waits in the batch: no pixel of one triangle
+// is queued twice, so the late color write can't overtake a depth decision.
+template <bool Partial, bool DepthTest>
+static void
+shadeTexturedSpan(Framebuffer& p_Fb, const TriangleSetup& p_Setup, const UvPlanes& p_Planes, uint32_t p_Color,
+  const Texture& p_Texture, int p_X0, int p_Y0, int p_X1, int p_Y1, SampleBatch& p_Batch, RasterCounters& p_Counters)
+{
+  StatsRecorder* stats = p_Fb.stats;
+  const int width = p_Fb.width;
+
+  int64_t edgeRow[3];
+  for (int i = 0; i < 3; i++)
+    edgeRow[i] = p_Setup.edge[i]
+      + (int64_t)(p_X0 - p_Setup.originX) * p_Setup.stepX[i]
+      + (int64_t)(p_Y0 - p_Setup.originY) * p_Setup.stepY[i];
+
+  for (int y = p_Y0; y <= p_Y1; y++)
+  {
+    const int colorY = p_Fb.flipVertically ? p_Fb.height - 1 - y : y;
+    uint32_t* colorRow = p_Fb.color + (size_t)colorY * width;
+    const size_t depthRow = (size_t)y * width;
+    const float rowY = (float)(y - p_Setup.originY);
+    const float zRow = p_Setup.zOrigin + rowY * p_Setup.zStepY;
+    const float uRow = p_Planes.uOrigin + rowY * p_Planes.uStepY;
+    const float vRow = p_Planes.vOrigin + rowY * p_Planes.vStepY;
+
+    int64_t e0 = edgeRow[0];
+    int64_t e1 = edgeRow[1];
+    int64_t e2 = edgeRow[2];
+    for (int x = p_X0; x <= p_X1; x++)
+    {
+      if (!Partial || (e0 | e1 | e2) >= 0)
+      {
+        ++p_Counters.covered;
+        const float columnX = (float)(x - p_Setup.originX);
+        bool passed = true;
+        if constexpr (DepthTest)
+        {
+          const float z = zRow + columnX * p_Setup.zStepX;
+          passed = p_Fb.depth[depthRow + x] < z;
+          if (passed)
+          {
+            p_Fb.depth[depthRow + x] = z;
+            ++p_Counters.depthPassed;
+          }
+          else
+            ++p_Counters.depthFailed;
+        }
+        if (passed)
+        {
+          p_Batch.u[p_Batch.count] = uRow + columnX * p_Planes.uStepX;
+          p_Batch.v[p_Batch.count] = vRow + columnX * p_Planes.vStepX;
+          p_Batch.color[p_Batch.count] = colorRow + x;
+          if (ms_SampleBatch == ++p_Batch.count)
+            flushSamples(p_Batch, p_Texture, p_Color);
+          if (stats) stats->touchPixel(depthRow + x);
+        }
+      }
+      if constexpr (Partial)
+      {
+        e0 += p_Setup.stepX[0];
+        e1 += p_Setup.stepX[1];
+        e2 += p_Setup.stepX[2];
+      }
+    }
+    if constexpr (Partial)
+    {
+      edgeRow[0] += p_Setup.stepY[0];
+      edgeRow[1] += p_Setup.stepY[1];
+      edgeRow[2] += p_Setup.stepY[2];
+    }
+  }
+}
+//---------------------------------------------------------------------------//
+// The blocks of drawTriangle's row walk, only the shading differs. Textured
+// triangles always walk rows, setRasterTraversal applies to drawTriangle.
+template <bool DepthTest>
+static void
+rasterizeTextured(Framebuffer& p_Fb, const TriangleSetup& p_Setup, const UvPlanes& p_Planes, uint32_t p_Color,
+  const Texture& p_Texture, RasterCounters& p_Counters)
+{
+  SampleBatch batch;
+  walkBlockRows(p_Setup, p_Counters, [&](BlockKind p_Kind, int p_X0, int p_Y0, int p_X1, int p_Y1) {
+    if (BlockKind::Partial == p_Kind)
+      shadeTexturedSpan<true, DepthTest>(p_Fb, p_Setup, p_Planes, p_Color, p_Texture, p_X0, p_Y0, p_X1, p_Y1, batch, p_Counters);
+    else
+      shadeTexturedSpan<false, DepthTest>(p_Fb, p_Setup, p_Planes, p_Color, p_Texture, p_X0, p_Y0, p_X1, p_Y1, batch, p_Counters);
+  });
+  if (batch.count)
+    flushSamples(batch, p_Texture, p_Color);
+}
+//---------------------------------------------------------------------------//
+void
+rasterizeSetupTextured(Framebuffer& p_Fb, const TriangleSetup& p_Setup, const UvPlanes& p_Planes, uint32_t p_Color,
+  const Texture& p_Texture, bool p_DepthTest, RasterCounters& p_Counters)
+{
+  if (p_DepthTest)
+    rasterizeTextured<true>(p_Fb, p_Setup, p_Planes, p_Color, p_Texture, p_Counters);
+  else
+    rasterizeTextured<false>(p_Fb, p_Setup, p_Planes, p_Color, p_Texture, p_Counters);
+}
+
+//---------------------------------------------------------------------------//
+// Rendering functions
+//---------------------------------------------------------------------------//
+// p_Corners is the triangle or a part of it clipped to the guard band, the
+// uv planes always come from the whole triangle
+static void
+drawTexturedPart(Framebuffer& p_Fb, const Vec3F p_Corners[3], const Vec3F p_TriangleVertices[3], const Vec2F p_Uvs[3],
+  uint32_t p_Color, const Texture& p_Texture, bool p_DepthTest)
+{
+  StatsRecorder* stats = p_Fb.stats;
+
+  TriangleSetup setup;
+  bool degenerate = false;
+  if (!setupTriangle(p_Fb, p_Corners, setup, degenerate))
+  {
+    if (stats)
+    {
+      stats->current.trianglesRasterized++;
+      stats->current.trianglesDegenerate += degenerate;
+    }
+    return;
+  }
+
+  RasterCounters counters;
+  rasterizeSetupTextured(p_Fb, setup, setupUvPlanes(setup, p_TriangleVertices, p_Uvs), p_Color, p_Texture, p_DepthTest, counters);
+
+  if (stats)
+  {
+    RasterStats& current = stats->current;
+    current.trianglesRasterized++;
+    current.bboxPixels += (uint64_t)(setup.maxX - setup.minX + 1) * (setup.maxY - setup.minY + 1);
+    addRasterCounters(current, counters, p_DepthTest);
+  }
+}
+//---------------------------------------------------------------------------//
+void
+drawTriangleTextured(Framebuffer& p_Fb, const Vec3F p_TriangleVertices[3], const Vec2F p_Uvs[3], uint32_t p_Color,
+  const Texture& p_Texture, bool p_DepthTest)
+{
+  if (isInsideGuardBand(p_TriangleVertices))
+  {
+    drawTexturedPart(p_Fb, p_TriangleVertices, p_TriangleVertices, p_Uvs, p_Color, p_Texture, p_DepthTest);
+    return;
+  }
+
+  ClippedTriangles clipped;
+  clipToGuardBand(p_TriangleVertices, clipped);
+  if (p_Fb.stats)
+    p_Fb.stats->current.trianglesClipped++;
+  for (int i = 0; i < clipped.count; i++)
+    drawTexturedPart(p_Fb, clipped.corners[i], p_TriangleVertices, p_Uvs, p_Color, p_Texture, p_DepthTest);
+}
@@ -0,0 +1,223 @@
+// Raster_Tiles.cpp : sort-middle drawTriangles and drawTrianglesTextured.
+// Description: triangles are set up and binned into screen tiles on the
+// calling thread, then the job system rasterizes whole tiles. A tile belongs
+// to one worker at a time, so the pixel loops run without locks or atomics.
+//
+
+#include "Raster.hpp"
+#include "Raster_Kernels.hpp"
+#include "Profiler.hpp"
+#include "Job_System.hpp"
+
+#include <algorithm>
+#include <vector>
+
+//---------------------------------------------------------------------------//
+// Tile bins
+//---------------------------------------------------------------------------//
+// 64x64 colors and depths are 32 KB, about what a core keeps in L1/L2 while
+// a tile is drawn. Rounded up to whole blocks so the blocks a tile walks are
+// the blocks drawTriangle walks and the block counters come out the same.
+static constexpr int ms_TileSize = (64 + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE * RASTER_BLOCK_SIZE;
+//---------------------------------------------------------------------------//
+struct TileBins
+{
+  std::vector<TriangleSetup> setups;
+  std::vector<uint32_t> sources; // index of every setup's triangle in the draw
+
+  // setups indices sorted by tile, tile t owns [tileStart[t], tileStart[t + 1])
+  std::vector<uint32_t> tileStart;
+  std::vector<uint32_t> tileTriangles;
+
+  // tiles with at least one triangle, the only ones that become jobs
+  std::vector<uint32_t> activeTiles;
+};
+//---------------------------------------------------------------------------//
+// Per worker, padded so no two workers share a cache line
+struct alignas(64) TileWorker
+{
+  RasterCounters counters;
+  StatsRecorder stats;
+};
+//---------------------------------------------------------------------------//
+// Kept between draws so binning does not allocate once the sizes settle
+static thread_local TileBins g_TileBins;
+
+//---------------------------------------------------------------------------//
+// Sets up every triangle and sorts them into the tiles their bounding boxes
+// touch. Two counting passes keep the submission order inside every tile,
+// which keeps depth ties and the depth-less passes identical to drawTriangle.
+static void
+binTriangles(const Framebuffer& p_Fb, const ScreenTriangle* p_Triangles, size_t p_Count,
+  int p_TilesX, int p_TilesY, TileBins& p_Bins)
+{
+  RASTER_PROFILE_ZONE("bin");
+  StatsRecorder* stats = p_Fb.stats;
+
+  p_Bins.setups.clear();
+  p_Bins.sources.clear();
+  p_Bins.setups.reserve(p_Count);
+  p_Bins.sources.reserve(p_Count);
+  p_Bins.tileStart.assign((size_t)p_TilesX * p_TilesY + 1, 0);
+
+  auto bin = [&](const Vec3F p_Corners[3], uint32_t p_Source) {
+    TriangleSetup setup;
+    bool degenerate = false;
+    const bool visible = setupTriangle(p_Fb, p_Corners, setup, degenerate);
+    if (stats)
+    {
+      stats->current.trianglesRasterized++;
+      stats->current.trianglesDegenerate += degenerate;
+    }
+    if (!visible)
+      return;
+    if (stats)
+      stats->current.bboxPixels += (uint64_t)(setup.maxX - setup.minX + 1) * (setup.maxY - setup.minY + 1);
+
+    for (int tileY = setup.minY / ms_TileSize; tileY <= setup.maxY / ms_TileSize; tileY++)
+      for (int tileX = setup.minX / ms_TileSize; tileX <= setup.maxX / ms_TileSize; tileX++)
+        p_Bins.tileStart[(size_t)tileY * p_TilesX + tileX + 1]++;
+
+    p_Bins.setups.push_back(setup);
+    p_Bins.sources.push_back(p_Source);
+  };
+
+  for (size_t i = 0; i < p_Count; i++)
+  {
+    if (isInsideGuardBand(p_Triangles[i].pos))
+    {
+      bin(p_Triangles[i].pos, (uint32_t)i);
+      continue;
+    }
+
+    // the parts of a clipped triangle share its source index and follow each
+    // other, like drawTriangle draws them:
+    ClippedTriangles clipped;
+    clipToGuardBand(p_Triangles[i].pos, clipped);
+    if (stats)
+      stats->current.trianglesClipped++;
+    for (int c = 0; c < clipped.count; c++)
+      bin(clipped.corners[c], (uint32_t)i);
+  }
+
+  for (size_t t = 1; t < p_Bins.tileStart.size(); t++)
+    p_Bins.tileStart[t] += p_Bins.tileStart[t - 1];
+  p_Bins.tileTriangles.resize(p_Bins.tileStart.back());
+
+  // tileStart[t] doubles as the write cursor of tile t - 1, it ends up at the
+  // tile's own start again after the pass:
+  for (uint32_t s = 0; s < (uint32_t)p_Bins.setups.size(); s++)
+  {
+    const TriangleSetup& setup = p_Bins.setups[s];
+    for (int tileY = setup.minY / ms_TileSize; tileY <= setup.maxY / ms_TileSize; tileY++)
+      for (int tileX = setup.minX / ms_TileSize; tileX <= setup.maxX / ms_TileSize; tileX++)
+        p_Bins.tileTriangles[p_Bins.tileStart[(size_t)tileY * p_TilesX + tileX]++] = s;
+  }
+  for (size_t t = p_Bins.tileStart.size() - 1; t > 0; t--)
+    p_Bins.tileStart[t] = p_Bins.tileStart[t - 1];
+  p_Bins.tileStart[0] = 0;
+
+  p_Bins.activeTiles.clear();
+  for (uint32_t t = 0; t + 1 < (uint32_t)p_Bins.tileStart.size(); t++)
+    if (p_Bins.tileStart[t] != p_Bins.tileStart[t + 1])
+      p_Bins.activeTiles.push_back(t);
+}
+//---------------------------------------------------------------------------//
+// Bins the triangles and rasterizes the tiles on the job system, p_Rasterize
+// (fb, setup, triangle index, counters) draws the part of one triangle that
+// is inside the setup's rectangle
+template <typename RasterizeFn>
+static void
+drawBinned(Framebuffer& p_Fb, const ScreenTriangle* p_Triangles, size_t p_Count, bool p_DepthTest,
+  const RasterizeFn& p_Rasterize)
+{
+  const int tilesX = (p_Fb.width + ms_TileSize - 1) / ms_TileSize;
+  const int tilesY = (p_Fb.height + ms_TileSize - 1) / ms_TileSize;
+  TileBins& bins = g_TileBins;
+  binTriangles(p_Fb, p_Triangles, p_Count, tilesX, tilesY, bins);
+
+  std::vector<TileWorker> workers(JobSystem::getSlotCount());
+  if (p_Fb.stats)
+    for (TileWorker& worker : workers)
+      worker.stats.beginWorker(*p_Fb.stats);
+
+  // one job per tile: a dense tile next to empty background is just a longer
+  // job, idle workers steal the remaining ones meanwhile
+  JobSystem::parallelFor((uint32_t)bins.activeTiles.size(), 1, [&](uint32_t p_Begin, uint32_t p_End, uint32_t p_Worker) {
+    TileWorker& worker = workers[p_Worker];
+    Framebuffer fb = p_Fb;
+    fb.stats = p_Fb.stats ? &worker.stats : nullptr;
+
+    for (uint32_t active = p_Begin; active < p_End; active++)
+    {
+      RASTER_PROFILE_ZONE("raster tile");
+      const uint32_t tile = bins.activeTiles[active];
+      const int tileX0 = (int)(tile % tilesX) * ms_TileSize;
+      const int tileY0 = (int)(tile / tilesX) * ms_TileSize;
+      const int tileX1 = std::min(tileX0 + ms_TileSize, p_Fb.width) - 1;
+      const int tileY1 = std::min(tileY0 + ms_TileSize, p_Fb.height) - 1;
+
+      for (uint32_t i = bins.tileStart[tile]; i < bins.tileStart[tile + 1]; i++)
+      {
+        const uint32_t s = bins.tileTriangles[i];
+
+        // the origin stays, only the walked rectangle shrinks to the tile:
+        TriangleSetup setup = bins.setups[s];
+        setup.minX = std::max(setup.minX, tileX0);
+        setup.minY = std::max(setup.minY, tileY0);
+        setup.maxX = std::min(setup.maxX, tileX1);
+        setup.maxY = std::min(setup.maxY, tileY1);
+        p_Rasterize(fb, setup, bins.sources[s], worker.counters);
+      }
+    }
+  });
+
+  if (p_Fb.stats)
+  {
+    for (TileWorker& worker : workers)
+    {
+      p_Fb.stats->mergeWorker(worker.stats);
+      addRasterCounters(p_Fb.stats->current, worker.counters, p_DepthTest);
+    }
+  }
+}
+
+//---------------------------------------------------------------------------//
+// Rendering functions
+//---------------------------------------------------------------------------//
+void
+drawTriangles(Framebuffer& p_Fb, const ScreenTriangle* p_Triangles, size_t p_Count, bool p_DepthTest)
+{
+  if (JobSystem::getThreadCount() <= 1)
+  {
+    for (size_t i = 0; i < p_Count; i++)
+      drawTriangle(p_Fb, p_Triangles[i].pos, p_Triangles[i].color, p_DepthTest);
+    return;
+  }
+
+  drawBinned(p_Fb, p_Triangles, p_Count, p_DepthTest,
+    [&](Framebuffer& p_TileFb, const TriangleSetup& p_Setup, uint32_t p_Triangle, RasterCounters& p_Counters) {
+      rasterizeSetup(p_TileFb, p_Setup, p_Triangles[p_Triangle].color, p_DepthTest, p_Counters);
+    });
+}
+//---------------------------------------------------------------------------//
+void
+drawTrianglesTextured(Framebuffer& p_Fb, const ScreenTriangle* p_Triangles, const TriangleUvs* p_Uvs, size_t p_Count,
+  const Texture& p_Texture, bool p_DepthTest)
+{
+  if (JobSystem::getThreadCount() <= 1)
+  {
+    for (size_t i = 0; i < p_Count; i++)
+      drawTriangleTextured(p_Fb, p_Triangles[i].pos, p_Uvs[i].uv, p_Triangles[i].color, p_Texture, p_DepthTest);
+    return;
+  }
+
+  // the uv planes are anchored at the setup's origin like the depth plane,
+  // so every tile a triangle touches computes the same coordinates. They come
+  // from the source triangle, the parts of a clipped one lie in its planes:
+  drawBinned(p_Fb, p_Triangles, p_Count, p_DepthTest,
+    [&](Framebuffer& p_TileFb, const TriangleSetup& p_Setup, uint32_t p_Triangle, RasterCounters& p_Counters) {
+      const UvPlanes planes = setupUvPlanes(p_Setup, p_Triangles[p_Triangle].pos, p_Uvs[p_Triangle].uv);
+      rasterizeSetupTextured(p_TileFb, p_Setup, planes, p_Triangles[p_Triangle].color, p_Texture, p_DepthTest, p_Counters);
+    });
+}
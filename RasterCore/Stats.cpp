@@ -0,0 +1,113 @@
+// Stats.cpp : pipeline statistics.
+//
+
+#include "Stats.hpp"
+
+#include <cassert>
+
+//---------------------------------------------------------------------------//
+// RasterStats
+//---------------------------------------------------------------------------//
+RasterStats&
+RasterStats::operator +=(const RasterStats& p_Other)
+{
+  facesSubmitted += p_Other.facesSubmitted;
+  facesCulled += p_Other.facesCulled;
+  trianglesRasterized += p_Other.trianglesRasterized;
+  trianglesDegenerate += p_Other.trianglesDegenerate;
+  trianglesClipped += p_Other.trianglesClipped;
+  bboxPixels += p_Other.bboxPixels;
+  blocksSkipped += p_Other.blocksSkipped;
+  blocksFull += p_Other.blocksFull;
+  blocksPartial += p_Other.blocksPartial;
+  pixelsCovered += p_Other.pixelsCovered;
+  depthTestsPassed += p_Other.depthTestsPassed;
+  depthTestsFailed += p_Other.depthTestsFailed;
+  pixelsWritten += p_Other.pixelsWritten;
+  pixelsUnique += p_Other.pixelsUnique;
+  return *this;
+}
+
+//---------------------------------------------------------------------------//
+// StatsRecorder
+//---------------------------------------------------------------------------//
+void
+StatsRecorder::beginFrame(int p_Width, int p_Height)
+{
+  const size_t pixelCount = (size_t)p_Width * p_Height;
+  if (m_LastDraw.size() != pixelCount || UINT32_MAX - m_DrawId < (1u << 20))
+  {
+    // new size (or running out of ids), start over:
+    m_LastDraw.assign(pixelCount, 0);
+    m_DrawId = 0;
+  }
+  m_LastDrawIds = m_LastDraw.data();
+
+  m_FrameFirstDrawId = m_DrawId + 1;
+  m_FrameUnique = 0;
+  frame = {};
+  lastDraw = {};
+  current = {};
+}
+//---------------------------------------------------------------------------//
+void
+StatsRecorder::beginDraw()
+{
+  assert(!m_LastDraw.empty() && "beginFrame has to be called first");
+  ++m_DrawId;
+  current = {};
+}
+//---------------------------------------------------------------------------//
+void
+StatsRecorder::endDraw()
+{
+  lastDraw = current;
+  frame += current;
+
+  // per draw unique counts overlap, the frame keeps its own:
+  frame.pixelsUnique = m_FrameUnique;
+}
+
+//---------------------------------------------------------------------------//
+void
+StatsRecorder::beginWorker(const StatsRecorder& p_Owner)
+{
+  m_LastDrawIds = p_Owner.m_LastDrawIds;
+  m_DrawId = p_Owner.m_DrawId;
+  m_FrameFirstDrawId = p_Owner.m_FrameFirstDrawId;
+  m_FrameUnique = 0;
+  current = {};
+}
+//---------------------------------------------------------------------------//
+void
+StatsRecorder::mergeWorker(const StatsRecorder& p_Worker)
+{
+  current += p_Worker.current;
+  m_FrameUnique += p_Worker.m_FrameUnique;
+}
+
+//---------------------------------------------------------------------------//
+// Helper functions
+//---------------------------------------------------------------------------//
+void
+printStats(FILE* p_File, const char* p_Label, const RasterStats& p_Stats)
+{
+  fprintf(p_File,
+    "{\"label\": \"%s\", \"faces_submitted\": %llu, \"faces_culled\": %llu, "
+    "\"triangles_rasterized\": %llu, \"triangles_degenerate\": %llu, \"triangles_clipped\": %llu, "
+    "\"bbox_pixels\": %llu, \"blocks_skipped\": %llu, \"blocks_full\": %llu, \"blocks_partial\": %llu, "
+    "\"pixels_covered\": %llu, \"coverage_efficiency\": %.4f, "
+    "\"depth_passed\": %llu, \"depth_failed\": %llu, "
+    "\"pixels_written\": %llu, \"pixels_unique\": %llu, \"overdraw\": %.4f}\n",
+    p_Label,
+    (unsigned long long)p_Stats.facesSubmitted, (unsigned long long)p_Stats.facesCulled,
+    (unsigned long long)p_Stats.trianglesRasterized, (unsigned long long)p_Stats.trianglesDegenerate,
+    (unsigned long long)p_Stats.trianglesClipped,
+    (unsigned long long)p_Stats.bboxPixels,
+    (unsigned long long)p_Stats.blocksSkipped, (unsigned long long)p_Stats.blocksFull, (unsigned long long)p_Stats.blocksPartial,
+    (unsigned long long)p_Stats.pixelsCovered,
+    p_Stats.coverageEfficiency(),
+    (unsigned long long)p_Stats.depthTestsPassed, (unsigned long long)p_Stats.depthTestsFailed,
+    (unsigned long long)p_Stats.pixelsWritten, (unsigned long long)p_Stats.pixelsUnique,
+    p_Stats.overdrawRatio());
+}
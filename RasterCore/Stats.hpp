@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+//---------------------------------------------------------------------------//
+// Pipeline counters of one draw call (model pass) or one frame
+//---------------------------------------------------------------------------//
+struct RasterStats
+{
+  uint64_t facesSubmitted = 0;
+  uint64_t facesCulled = 0;         // rejected by the intensity > 0 test
+  uint64_t trianglesRasterized = 0;
+  uint64_t trianglesDegenerate = 0; // zero area after snapping to the sub-pixel grid
+  uint64_t trianglesClipped = 0;    // crossed the guard band, their parts count as rasterized
+  uint64_t bboxPixels = 0;          // pixels inside the clamped bounding boxes
+  uint64_t blocksSkipped = 0;       // coarse blocks outside the triangle
+  uint64_t blocksFull = 0;          // coarse blocks filled without coverage tests
+  uint64_t blocksPartial = 0;       // coarse blocks rasterized per pixel
+  uint64_t pixelsCovered = 0;       // inside the triangle
+  uint64_t depthTestsPassed = 0;
+  uint64_t depthTestsFailed = 0;
+  uint64_t pixelsWritten = 0;
+  uint64_t pixelsUnique = 0;        // distinct pixels written
+
+  // writes per distinct pixel, 1.0 means every pixel was shaded once:
+  double overdrawRatio() const { return pixelsUnique ? (double)pixelsWritten / pixelsUnique : 0.0; }
+
+  // share of the bounding box pixels that are covered:
+  double coverageEfficiency() const { return bboxPixels ? (double)pixelsCovered / bboxPixels : 0.0; }
+
+  RasterStats& operator +=(const RasterStats& p_Other);
+};
+
+//---------------------------------------------------------------------------//
+// Collects RasterStats while drawing. Attach it to Framebuffer::stats, the
+// model passes open and close a draw, the front-end opens and closes frames.
+//---------------------------------------------------------------------------//
+struct StatsRecorder
+{
+  RasterStats frame;    // finished draws of the current frame
+  RasterStats lastDraw; // last finished draw
+  RasterStats current;  // draw in progress
+
+  //---------------------------------------------------------------------------//
+  void
+  beginFrame(int p_Width, int p_Height);
+  //---------------------------------------------------------------------------//
+  void
+  beginDraw();
+  //---------------------------------------------------------------------------//
+  void
+  endDraw();
+  //---------------------------------------------------------------------------//
+  // Turns this recorder into the one of a worker thread of a parallel draw
+  // of p_Owner: it shares the owner's per-pixel ids (workers write disjoint
+  // pixels) and counts into its own current. Hand it back with mergeWorker.
+  void
+  beginWorker(const StatsRecorder& p_Owner);
+  //---------------------------------------------------------------------------//
+  void
+  mergeWorker(const StatsRecorder& p_Worker);
+  //---------------------------------------------------------------------------//
+  // Called for every pixel write, p_Index is y * width + x
+  inline void
+  touchPixel(size_t p_Index)
+  {
+    const uint32_t last = m_LastDrawIds[p_Index];
+    current.pixelsUnique += (last != m_DrawId);
+    m_FrameUnique += (last < m_FrameFirstDrawId);
+    m_LastDrawIds[p_Index] = m_DrawId;
+  }
+
+private:
+  // id of the last draw that wrote each pixel, ids only ever grow so the
+  // buffer does not need clearing between draws or frames
+  std::vector<uint32_t> m_LastDraw;
+  uint32_t* m_LastDrawIds = nullptr; // m_LastDraw, or the owner's for workers
+  uint32_t m_DrawId = 0;
+  uint32_t m_FrameFirstDrawId = 1;
+  uint64_t m_FrameUnique = 0;
+};
+
+//---------------------------------------------------------------------------//
+// Prints p_Stats as a single json object line
+void
+printStats(FILE* p_File, const char* p_Label, const RasterStats& p_Stats);
@@ -0,0 +1,151 @@
+// Texture.cpp : tiled RGBA8 textures and their samplers.
+// Description: the conversion from TGAImage, the scalar samplers and the
+// dispatch of the batched ones to the per-ISA kernels
+//
+
+#include "Texture.hpp"
+#include "Texture_Kernels.hpp"
+#include "Profiler.hpp"
+
+#include <tinyrenderer/tgaimage.h>
+
+#include <cmath>
+#include <cstdio>
+
+//---------------------------------------------------------------------------//
+// Conversion
+//---------------------------------------------------------------------------//
+Texture::Texture(const TGAImage& p_Image)
+{
+  RASTER_PROFILE_ZONE("tile texture");
+  const int width = p_Image.width();
+  const int height = p_Image.height();
+  if (width <= 0 || height <= 0)
+    return;
+  if (width > ms_MaxSize || height > ms_MaxSize)
+  {
+    fprintf(stderr, "texture of %dx%d texels is larger than %d\n", width, height, ms_MaxSize);
+    return;
+  }
+
+  // whole tiles, the padding is never sampled:
+  const uint32_t tilesX = (uint32_t)(width + ms_TileSize - 1) / ms_TileSize;
+  const uint32_t tilesY = (uint32_t)(height + ms_TileSize - 1) / ms_TileSize;
+  m_Width = width;
+  m_Height = height;
+  m_TileRowTexels = tilesX * ms_TileTexels;
+  m_Texels.assign((size_t)m_TileRowTexels * tilesY, 0);
+
+  // the image comes top row first, the texture keeps the bottom row at v = 0:
+  std::vector<BGRA8> row(width);
+  p_Image.visit_pixels([&](const auto& p_Pixels) {
+    for (int y = 0; y < height; y++)
+    {
+      p_Pixels.read_row(height - 1 - y, row.data());
+      uint32_t* texels = m_Texels.data() + getRowOffset(y);
+      for (int x = 0; x < width; x++)
+      {
+        const BGRA8 p = row[x];
+        texels[getColumnOffset(x)] = (uint32_t)p.r | ((uint32_t)p.g << 8) | ((uint32_t)p.b << 16) | ((uint32_t)p.a << 24);
+      }
+    }
+  });
+}
+
+//---------------------------------------------------------------------------//
+// Scalar samplers
+//---------------------------------------------------------------------------//
+// The steps of Texture_Kernels.hpp one lane at a time, the comparisons
+// written the way maxps and minps treat NaN
+static inline float
+wrapCoordinate(float p_U)
+{
+  float f = p_U - std::floor(p_U);
+  f = f > 0.0f ? f : 0.0f;
+  return f < 1.0f ? f : 1.0f;
+}
+//---------------------------------------------------------------------------//
+static inline uint32_t
+pointTexel(float p_U, int p_Size)
+{
+  const int x = (int)(wrapCoordinate(p_U) * (float)p_Size);
+  return (uint32_t)(x == p_Size ? 0 : x);
+}
+//---------------------------------------------------------------------------//
+// Lower texel and the weight of the upper one
+static inline void
+bilinearTexels(float p_U, int p_Size, uint32_t& p_X0, uint32_t& p_X1, uint32_t& p_Weight)
+{
+  const float s = wrapCoordinate(p_U) * ((float)p_Size * ms_TexelFraction) - ms_TexelFraction / 2;
+  const int fixed = (int)std::floor(s);
+  int x0 = fixed >> 8;
+  x0 = x0 < 0 ? x0 + p_Size : x0;
+  const int x1 = x0 + 1;
+  p_X0 = (uint32_t)x0;
+  p_X1 = (uint32_t)(x1 == p_Size ? 0 : x1);
+  p_Weight = (uint32_t)fixed & 255;
+}
+//---------------------------------------------------------------------------//
+uint32_t
+Texture::samplePoint(float p_U, float p_V) const
+{
+  return m_Texels[getRowOffset(pointTexel(p_V, m_Height)) + getColumnOffset(pointTexel(p_U, m_Width))];
+}
+//---------------------------------------------------------------------------//
+uint32_t
+Texture::sampleBilinear(float p_U, float p_V) const
+{
+  uint32_t x0, x1, weightX, y0, y1, weightY;
+  bilinearTexels(p_U, m_Width, x0, x1, weightX);
+  bilinearTexels(p_V, m_Height, y0, y1, weightY);
+
+  const uint32_t* row0 = m_Texels.data() + getRowOffset(y0);
+  const uint32_t* row1 = m_Texels.data() + getRowOffset(y1);
+  const uint32_t column0 = getColumnOffset(x0);
+  const uint32_t column1 = getColumnOffset(x1);
+  const uint32_t bottom = lerpTexels(row0[column0], row0[column1], weightX);
+  const uint32_t top = lerpTexels(row1[column0], row1[column1], weightX);
+  return lerpTexels(bottom, top, weightY);
+}
+
+//---------------------------------------------------------------------------//
+// Batched samplers
+//---------------------------------------------------------------------------//
+// Follows the drawTriangle kernels, avx-512 cpus run the avx2 samplers
+static const TextureKernels*
+getTextureKernels()
+{
+  switch (getRasterIsa())
+  {
+  case RasterIsa::Sse41:  return getSse41TextureKernels();
+  case RasterIsa::Avx2:
+  case RasterIsa::Avx512: return getAvx2TextureKernels();
+  default:                return nullptr;
+  }
+}
+//---------------------------------------------------------------------------//
+void
+Texture::samplePoint(const float* p_U, const float* p_V, uint32_t p_Count, uint32_t* p_Texels) const
+{
+  uint32_t done = 0;
+  if (const TextureKernels* kernels = getTextureKernels())
+  {
+    done = p_Count - p_Count % kernels->lanes;
+    kernels->samplePoint(*this, p_U, p_V, done, p_Texels);
+  }
+  for (uint32_t i = done; i < p_Count; i++)
+    p_Texels[i] = samplePoint(p_U[i], p_V[i]);
+}
+//---------------------------------------------------------------------------//
+void
+Texture::sampleBilinear(const float* p_U, const float* p_V, uint32_t p_Count, uint32_t* p_Texels) const
+{
+  uint32_t done = 0;
+  if (const TextureKernels* kernels = getTextureKernels())
+  {
+    done = p_Count - p_Count % kernels->lanes;
+    kernels->sampleBilinear(*this, p_U, p_V, done, p_Texels);
+  }
+  for (uint32_t i = done; i < p_Count; i++)
+    p_Texels[i] = sampleBilinear(p_U[i], p_V[i]);
+}
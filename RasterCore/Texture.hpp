@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct TGAImage;
+
+//---------------------------------------------------------------------------//
+// RGBA8 texture (red in the low byte, like the framebuffer) converted from a
+// TGAImage at load time. Texels are stored in 4x4 tiles of 64 bytes, one
+// cache line each, the tiles row-major. A bilinear footprint and the texels
+// of neighbouring pixels mostly land in the same line, where a linear layout
+// touches a new line per texel row.
+//
+// Texture coordinates follow the obj files: (0, 0) is the bottom left corner
+// of the image, v points up and both wrap around (repeat addressing). The
+// scalar and simd samplers return bit identical texels.
+//---------------------------------------------------------------------------//
+class Texture
+{
+public:
+  static constexpr int ms_TileSize = 4;
+  static constexpr int ms_TileTexels = ms_TileSize * ms_TileSize;
+
+  // keeps the tiled texel indices and the 24.8 bilinear positions in 32 bit
+  static constexpr int ms_MaxSize = 16384;
+
+  Texture() = default;
+  // Empty when p_Image has no pixels or is larger than ms_MaxSize
+  explicit Texture(const TGAImage& p_Image);
+
+  bool isValid() const { return !m_Texels.empty(); }
+  int getWidth() const { return m_Width; }
+  int getHeight() const { return m_Height; }
+
+  // Texel p_X, p_Y in the tiles, the sum of a column and a row offset
+  static uint32_t getColumnOffset(uint32_t p_X) { return (p_X >> 2) * ms_TileTexels + (p_X & 3); }
+  uint32_t getRowOffset(uint32_t p_Y) const { return (p_Y >> 2) * m_TileRowTexels + (p_Y & 3) * ms_TileSize; }
+  uint32_t getTileRowTexels() const { return m_TileRowTexels; }
+  const uint32_t* getTexels() const { return m_Texels.data(); }
+
+  // p_Y counts from the bottom row
+  uint32_t fetch(int p_X, int p_Y) const { return m_Texels[getRowOffset(p_Y) + getColumnOffset(p_X)]; }
+
+  //---------------------------------------------------------------------------//
+  // Nearest texel
+  uint32_t
+  samplePoint(float p_U, float p_V) const;
+  //---------------------------------------------------------------------------//
+  // 2x2 texels weighted in 8 bit fixed point
+  uint32_t
+  sampleBilinear(float p_U, float p_V) const;
+  //---------------------------------------------------------------------------//
+  // p_Count samples at once: 8 per step with the avx2 kernels and 4 with the
+  // sse4.1 ones (whatever getRasterIsa() picked), the rest one at a time
+  void
+  samplePoint(const float* p_U, const float* p_V, uint32_t p_Count, uint32_t* p_Texels) const;
+  //---------------------------------------------------------------------------//
+  void
+  sampleBilinear(const float* p_U, const float* p_V, uint32_t p_Count, uint32_t* p_Texels) const;
+
+private:
+  int m_Width = 0;
+  int m_Height = 0;
+  uint32_t m_TileRowTexels = 0; // texels in a row of tiles
+  std::vector<uint32_t> m_Texels;
+};
@@ -0,0 +1,74 @@
+// Texture_Avx2.cpp : texture samplers, 8 texels per step.
+// Description: the kernels use AVX2, only called after the cpuid check
+//
+
+#include "Texture_Kernels.hpp"
+
+#if RASTER_X86
+#include <immintrin.h>
+
+RASTER_TARGET_BEGIN("avx2")
+#include "Texture_Simd.hpp"
+
+//---------------------------------------------------------------------------//
+// The texels come in with vpgatherdd, one instruction per eight
+//---------------------------------------------------------------------------//
+namespace {
+struct TextureAvx2
+{
+  using Int = __m256i;
+  using Float = __m256;
+  static constexpr int ms_Lanes = 8;
+
+  static Int set(int32_t p_Value) { return _mm256_set1_epi32(p_Value); }
+  static Float setF(float p_Value) { return _mm256_set1_ps(p_Value); }
+  static Float loadF(const float* p_Src) { return _mm256_loadu_ps(p_Src); }
+  static void store(uint32_t* p_Dst, Int p_Value) { _mm256_storeu_si256((__m256i*)p_Dst, p_Value); }
+
+  static Int add(Int p_A, Int p_B) { return _mm256_add_epi32(p_A, p_B); }
+  static Int sub(Int p_A, Int p_B) { return _mm256_sub_epi32(p_A, p_B); }
+  static Int mul(Int p_A, Int p_B) { return _mm256_mullo_epi32(p_A, p_B); }
+  static Int andInt(Int p_A, Int p_B) { return _mm256_and_si256(p_A, p_B); }
+  static Int andNot(Int p_A, Int p_B) { return _mm256_andnot_si256(p_A, p_B); }
+  static Int equal(Int p_A, Int p_B) { return _mm256_cmpeq_epi32(p_A, p_B); }
+  static Int shiftLeft(Int p_A, int p_Bits) { return _mm256_slli_epi32(p_A, p_Bits); }
+  static Int shiftRight(Int p_A, int p_Bits) { return _mm256_srli_epi32(p_A, p_Bits); }
+  static Int shiftRightSigned(Int p_A, int p_Bits) { return _mm256_srai_epi32(p_A, p_Bits); }
+
+  static Float subF(Float p_A, Float p_B) { return _mm256_sub_ps(p_A, p_B); }
+  static Float mulF(Float p_A, Float p_B) { return _mm256_mul_ps(p_A, p_B); }
+  static Float maxF(Float p_A, Float p_B) { return _mm256_max_ps(p_A, p_B); }
+  static Float minF(Float p_A, Float p_B) { return _mm256_min_ps(p_A, p_B); }
+  static Float floorF(Float p_A) { return _mm256_floor_ps(p_A); }
+  static Int truncate(Float p_A) { return _mm256_cvttps_epi32(p_A); }
+
+  static Int mul16(Int p_A, Int p_B) { return _mm256_mullo_epi16(p_A, p_B); }
+  static Int add16(Int p_A, Int p_B) { return _mm256_add_epi16(p_A, p_B); }
+  static Int shiftRight16(Int p_A, int p_Bits) { return _mm256_srli_epi16(p_A, p_Bits); }
+
+  static Int
+  gather(const uint32_t* p_Texels, Int p_Indices)
+  {
+    return _mm256_i32gather_epi32((const int*)p_Texels, p_Indices, 4);
+  }
+};
+} // namespace
+
+//---------------------------------------------------------------------------//
+static constexpr TextureKernels ms_Avx2TextureKernels = makeSimdTextureKernels<TextureAvx2>();
+RASTER_TARGET_END
+
+//---------------------------------------------------------------------------//
+const TextureKernels*
+getAvx2TextureKernels()
+{
+  return &ms_Avx2TextureKernels;
+}
+#else
+//---------------------------------------------------------------------------//
+const TextureKernels*
+getAvx2TextureKernels()
+{
+  return nullptr;
+}
+#endif
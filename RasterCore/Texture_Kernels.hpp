@@ -0,0 +1,52 @@
+#pragma once
+
+// Internal to Texture: sampler kernels of the per-ISA translation units
+// (Texture_Sse41.cpp, Texture_Avx2.cpp)
+
+#include "Texture.hpp"
+#include "Raster_Kernels.hpp"
+
+//---------------------------------------------------------------------------//
+// Sampling in fixed point
+//---------------------------------------------------------------------------//
+// Every sampler runs the same float operations in the same order, so the
+// simd lanes and Texture::samplePoint/sampleBilinear pick the same texels:
+//   f  = u - floor(u), clamped to [0, 1] (NaN and inf turn into 0)
+//   point:    x = (int)(f * width), width wraps to 0
+//   bilinear: s = floor(f * width * 256 - 128) in 24.8 fixed point,
+//             x0 = s >> 8 (-1 wraps to width - 1), x1 = x0 + 1 (width
+//             wraps to 0), weight of x1 = s & 255
+// Two texels are blended per 16 bit channel lane, R/B and G/A apart:
+//   (a * (256 - w) + b * w + 128) >> 8
+// x first for the rows v0 and v1, then between the rows.
+static constexpr float ms_TexelFraction = 256.0f;
+static constexpr uint32_t ms_ChannelMask = 0x00FF00FF;
+static constexpr uint32_t ms_ChannelHalf = 0x00800080;
+//---------------------------------------------------------------------------//
+// p_Weight of p_B in [0, 255]
+static inline uint32_t
+lerpTexels(uint32_t p_A, uint32_t p_B, uint32_t p_Weight)
+{
+  const uint32_t inverse = 256 - p_Weight;
+  const uint32_t rb = ((p_A & ms_ChannelMask) * inverse + (p_B & ms_ChannelMask) * p_Weight + ms_ChannelHalf) >> 8;
+  const uint32_t ga = ((p_A >> 8) & ms_ChannelMask) * inverse + ((p_B >> 8) & ms_ChannelMask) * p_Weight + ms_ChannelHalf;
+  return (rb & ms_ChannelMask) | (ga & ~ms_ChannelMask);
+}
+
+//---------------------------------------------------------------------------//
+// Sampler kernels of one instruction set. They sample p_Count texels, a
+// multiple of lanes.
+//---------------------------------------------------------------------------//
+struct TextureKernels
+{
+  uint32_t lanes;
+  void (*samplePoint)(const Texture& p_Texture, const float* p_U, const float* p_V, uint32_t p_Count, uint32_t* p_Texels);
+  void (*sampleBilinear)(const Texture& p_Texture, const float* p_U, const float* p_V, uint32_t p_Count, uint32_t* p_Texels);
+};
+//---------------------------------------------------------------------------//
+// nullptr when the build target has no such instruction set (non x86)
+const TextureKernels*
+getSse41TextureKernels();
+//---------------------------------------------------------------------------//
+const TextureKernels*
+getAvx2TextureKernels();
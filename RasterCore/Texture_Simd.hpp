@@ -0,0 +1,145 @@
+#pragma once
+
+// Samplers written once against a small simd interface, included by the
+// per-ISA translation units inside their RASTER_TARGET_BEGIN region like
+// Raster_Simd.hpp. The unit includes Texture_Kernels.hpp before the region.
+//
+// The Simd interface (see Texture_Sse41.cpp):
+//   Int, Float, ms_Lanes
+//   set, setF, loadF, store, gather(texels, indices)
+//   add, sub, mul, andInt, andNot, equal, shiftLeft, shiftRight, shiftRightSigned
+//   subF, mulF, maxF, minF, floorF, truncate
+//   mul16, add16, shiftRight16 on the 16 bit halves of every lane
+
+//---------------------------------------------------------------------------//
+// f = u - floor(u) clamped to [0, 1], maxF and minF return the second operand
+// for NaN
+template <class Simd>
+static inline typename Simd::Float
+wrapCoordinateSimd(typename Simd::Float p_U)
+{
+  const typename Simd::Float f = Simd::subF(p_U, Simd::floorF(p_U));
+  return Simd::minF(Simd::maxF(f, Simd::setF(0.0f)), Simd::setF(1.0f));
+}
+//---------------------------------------------------------------------------//
+template <class Simd>
+static inline typename Simd::Int
+pointTexelSimd(typename Simd::Float p_U, int p_Size)
+{
+  const typename Simd::Int x = Simd::truncate(Simd::mulF(wrapCoordinateSimd<Simd>(p_U), Simd::setF((float)p_Size)));
+  return Simd::andNot(Simd::equal(x, Simd::set(p_Size)), x);
+}
+//---------------------------------------------------------------------------//
+template <class Simd>
+static inline void
+bilinearTexelsSimd(typename Simd::Float p_U, int p_Size,
+  typename Simd::Int& p_X0, typename Simd::Int& p_X1, typename Simd::Int& p_Weight)
+{
+  using Int = typename Simd::Int;
+  const typename Simd::Float s = Simd::subF(
+    Simd::mulF(wrapCoordinateSimd<Simd>(p_U), Simd::setF((float)p_Size * ms_TexelFraction)),
+    Simd::setF(ms_TexelFraction / 2));
+  const Int fixed = Simd::truncate(Simd::floorF(s));
+  const Int size = Simd::set(p_Size);
+
+  // -1 has the sign bit set, add the size back there:
+  Int x0 = Simd::shiftRightSigned(fixed, 8);
+  x0 = Simd::add(x0, Simd::andInt(Simd::shiftRightSigned(x0, 31), size));
+  const Int x1 = Simd::add(x0, Simd::set(1));
+  p_X0 = x0;
+  p_X1 = Simd::andNot(Simd::equal(x1, size), x1);
+  p_Weight = Simd::andInt(fixed, Simd::set(255));
+}
+//---------------------------------------------------------------------------//
+template <class Simd>
+static inline typename Simd::Int
+columnOffsetSimd(typename Simd::Int p_X)
+{
+  return Simd::add(Simd::shiftLeft(Simd::shiftRight(p_X, 2), 4), Simd::andInt(p_X, Simd::set(3)));
+}
+//---------------------------------------------------------------------------//
+template <class Simd>
+static inline typename Simd::Int
+rowOffsetSimd(typename Simd::Int p_Y, typename Simd::Int p_TileRowTexels)
+{
+  return Simd::add(Simd::mul(Simd::shiftRight(p_Y, 2), p_TileRowTexels), Simd::shiftLeft(Simd::andInt(p_Y, Simd::set(3)), 2));
+}
+//---------------------------------------------------------------------------//
+// lerpTexels per lane, p_Weight in both 16 bit halves of a lane
+template <class Simd>
+static inline typename Simd::Int
+lerpTexelsSimd(typename Simd::Int p_A, typename Simd::Int p_B, typename Simd::Int p_Weight)
+{
+  using Int = typename Simd::Int;
+  const Int mask = Simd::set((int32_t)ms_ChannelMask);
+  const Int half = Simd::set((int32_t)ms_ChannelHalf);
+  const Int inverse = Simd::sub(Simd::set(0x01000100), p_Weight);
+
+  const Int rb = Simd::add16(Simd::add16(
+    Simd::mul16(Simd::andInt(p_A, mask), inverse),
+    Simd::mul16(Simd::andInt(p_B, mask), p_Weight)), half);
+  const Int ga = Simd::add16(Simd::add16(
+    Simd::mul16(Simd::andInt(Simd::shiftRight(p_A, 8), mask), inverse),
+    Simd::mul16(Simd::andInt(Simd::shiftRight(p_B, 8), mask), p_Weight)), half);
+  return Simd::add(Simd::shiftRight16(rb, 8), Simd::andNot(mask, ga));
+}
+//---------------------------------------------------------------------------//
+template <class Simd>
+static void
+samplePointSimd(const Texture& p_Texture, const float* p_U, const float* p_V, uint32_t p_Count, uint32_t* p_Texels)
+{
+  using Int = typename Simd::Int;
+  const uint32_t* texels = p_Texture.getTexels();
+  const Int tileRowTexels = Simd::set((int32_t)p_Texture.getTileRowTexels());
+  const int width = p_Texture.getWidth();
+  const int height = p_Texture.getHeight();
+
+  for (uint32_t i = 0; i < p_Count; i += Simd::ms_Lanes)
+  {
+    const Int x = pointTexelSimd<Simd>(Simd::loadF(p_U + i), width);
+    const Int y = pointTexelSimd<Simd>(Simd::loadF(p_V + i), height);
+    const Int index = Simd::add(rowOffsetSimd<Simd>(y, tileRowTexels), columnOffsetSimd<Simd>(x));
+    Simd::store(p_Texels + i, Simd::gather(texels, index));
+  }
+}
+//---------------------------------------------------------------------------//
+template <class Simd>
+static void
+sampleBilinearSimd(const Texture& p_Texture, const float* p_U, const float* p_V, uint32_t p_Count, uint32_t* p_Texels)
+{
+  using Int = typename Simd::Int;
+  const uint32_t* texels = p_Texture.getTexels();
+  const Int tileRowTexels = Simd::set((int32_t)p_Texture.getTileRowTexels());
+  const int width = p_Texture.getWidth();
+  const int height = p_Texture.getHeight();
+
+  for (uint32_t i = 0; i < p_Count; i += Simd::ms_Lanes)
+  {
+    Int x0, x1, weightX, y0, y1, weightY;
+    bilinearTexelsSimd<Simd>(Simd::loadF(p_U + i), width, x0, x1, weightX);
+    bilinearTexelsSimd<Simd>(Simd::loadF(p_V + i), height, y0, y1, weightY);
+    weightX = Simd::add(weightX, Simd::shiftLeft(weightX, 16));
+    weightY = Simd::add(weightY, Simd::shiftLeft(weightY, 16));
+
+    const Int row0 = rowOffsetSimd<Simd>(y0, tileRowTexels);
+    const Int row1 = rowOffsetSimd<Simd>(y1, tileRowTexels);
+    const Int column0 = columnOffsetSimd<Simd>(x0);
+    const Int column1 = columnOffsetSimd<Simd>(x1);
+    const Int bottom = lerpTexelsSimd<Simd>(
+      Simd::gather(texels, Simd::add(row0, column0)), Simd::gather(texels, Simd::add(row0, column1)), weightX);
+    const Int top = lerpTexelsSimd<Simd>(
+      Simd::gather(texels, Simd::add(row1, column0)), Simd::gather(texels, Simd::add(row1, column1)), weightX);
+    Simd::store(p_Texels + i, lerpTexelsSimd<Simd>(bottom, top, weightY));
+  }
+}
+//---------------------------------------------------------------------------//
+template <class Simd>
+static constexpr TextureKernels
+makeSimdTextureKernels()
+{
+  return TextureKernels{
+    (uint32_t)Simd::ms_Lanes,
+    &samplePointSimd<Simd>,
+    &sampleBilinearSimd<Simd>
+  };
+}
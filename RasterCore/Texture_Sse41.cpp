@@ -0,0 +1,78 @@
+// Texture_Sse41.cpp : texture samplers, 4 texels per step.
+// Description: the kernels use SSE4.1, only called after the cpuid check
+//
+
+#include "Texture_Kernels.hpp"
+
+#if RASTER_X86
+#include <smmintrin.h>
+
+RASTER_TARGET_BEGIN("sse4.1")
+#include "Texture_Simd.hpp"
+
+//---------------------------------------------------------------------------//
+// SSE4.1 has no gather, the four texels are loaded one by one
+//---------------------------------------------------------------------------//
+namespace {
+struct TextureSse41
+{
+  using Int = __m128i;
+  using Float = __m128;
+  static constexpr int ms_Lanes = 4;
+
+  static Int set(int32_t p_Value) { return _mm_set1_epi32(p_Value); }
+  static Float setF(float p_Value) { return _mm_set1_ps(p_Value); }
+  static Float loadF(const float* p_Src) { return _mm_loadu_ps(p_Src); }
+  static void store(uint32_t* p_Dst, Int p_Value) { _mm_storeu_si128((__m128i*)p_Dst, p_Value); }
+
+  static Int add(Int p_A, Int p_B) { return _mm_add_epi32(p_A, p_B); }
+  static Int sub(Int p_A, Int p_B) { return _mm_sub_epi32(p_A, p_B); }
+  static Int mul(Int p_A, Int p_B) { return _mm_mullo_epi32(p_A, p_B); }
+  static Int andInt(Int p_A, Int p_B) { return _mm_and_si128(p_A, p_B); }
+  static Int andNot(Int p_A, Int p_B) { return _mm_andnot_si128(p_A, p_B); }
+  static Int equal(Int p_A, Int p_B) { return _mm_cmpeq_epi32(p_A, p_B); }
+  static Int shiftLeft(Int p_A, int p_Bits) { return _mm_slli_epi32(p_A, p_Bits); }
+  static Int shiftRight(Int p_A, int p_Bits) { return _mm_srli_epi32(p_A, p_Bits); }
+  static Int shiftRightSigned(Int p_A, int p_Bits) { return _mm_srai_epi32(p_A, p_Bits); }
+
+  static Float subF(Float p_A, Float p_B) { return _mm_sub_ps(p_A, p_B); }
+  static Float mulF(Float p_A, Float p_B) { return _mm_mul_ps(p_A, p_B); }
+  static Float maxF(Float p_A, Float p_B) { return _mm_max_ps(p_A, p_B); }
+  static Float minF(Float p_A, Float p_B) { return _mm_min_ps(p_A, p_B); }
+  static Float floorF(Float p_A) { return _mm_floor_ps(p_A); }
+  static Int truncate(Float p_A) { return _mm_cvttps_epi32(p_A); }
+
+  static Int mul16(Int p_A, Int p_B) { return _mm_mullo_epi16(p_A, p_B); }
+  static Int add16(Int p_A, Int p_B) { return _mm_add_epi16(p_A, p_B); }
+  static Int shiftRight16(Int p_A, int p_Bits) { return _mm_srli_epi16(p_A, p_Bits); }
+
+  static Int
+  gather(const uint32_t* p_Texels, Int p_Indices)
+  {
+    return _mm_setr_epi32(
+      (int)p_Texels[(uint32_t)_mm_cvtsi128_si32(p_Indices)],
+      (int)p_Texels[(uint32_t)_mm_extract_epi32(p_Indices, 1)],
+      (int)p_Texels[(uint32_t)_mm_extract_epi32(p_Indices, 2)],
+      (int)p_Texels[(uint32_t)_mm_extract_epi32(p_Indices, 3)]);
+  }
+};
+} // namespace
+
+//---------------------------------------------------------------------------//
+static constexpr TextureKernels ms_Sse41TextureKernels = makeSimdTextureKernels<TextureSse41>();
+RASTER_TARGET_END
+
+//---------------------------------------------------------------------------//
+const TextureKernels*
+getSse41TextureKernels()
+{
+  return &ms_Sse41TextureKernels;
+}
+#else
+//---------------------------------------------------------------------------//
+const TextureKernels*
+getSse41TextureKernels()
+{
+  return nullptr;
+}
+#endif
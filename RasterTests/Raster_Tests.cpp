@@ -0,0 +1,851 @@
+// Raster_Tests.cpp : This file contains the 'main' function.
+// Description: regression tests run by ctest, one test per command line
+// name. The fast paths have to draw the pixels of the plain ones and the
+// file formats have to give back what they were given.
+//
+
+#include <RasterCore/Asset_Loader.hpp>
+#include <RasterCore/Job_System.hpp>
+#include <RasterCore/Pipeline.hpp>
+#include <RasterCore/Texture.hpp>
+
+#include <tinyrenderer/model.h>
+#include <tinyrenderer/tgaimage.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef RASTER_ASSETS_DIR
+#define RASTER_ASSETS_DIR "../Assets"
+#endif
+
+#define HEAD_OBJ RASTER_ASSETS_DIR "/obj/african_head/african_head.obj"
+
+//---------------------------------------------------------------------------//
+// Test harness
+//---------------------------------------------------------------------------//
+static int g_Failures = 0;
+
+// Reports and counts a failed check, the test goes on
+#define TEST_CHECK(p_Condition)                                                         \
+  do                                                                                    \
+  {                                                                                     \
+    if (!(p_Condition))                                                                 \
+    {                                                                                   \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #p_Condition);   \
+      ++g_Failures;                                                                     \
+    }                                                                                   \
+  } while (0)
+
+//---------------------------------------------------------------------------//
+// Framebuffer with its own memory
+struct TestTarget
+{
+  std::vector<uint32_t> color;
+  std::vector<float> depth;
+  Framebuffer fb;
+
+  TestTarget(int p_Width, int p_Height)
+    : color((size_t)p_Width * p_Height), depth((size_t)p_Width * p_Height)
+  {
+    fb.width = p_Width;
+    fb.height = p_Height;
+    fb.color = color.data();
+    fb.depth = depth.data();
+  }
+  void clear()
+  {
+    clearBuffer(fb, BLACK);
+    clearDepthBuffer(fb);
+  }
+  bool operator ==(const TestTarget& p_Other) const
+  {
+    return color == p_Other.color && 0 == memcmp(depth.data(), p_Other.depth.data(), depth.size() * sizeof(float));
+  }
+  bool isFilledWith(uint32_t p_Color) const
+  {
+    return std::all_of(color.begin(), color.end(), [&](uint32_t p_Pixel) { return p_Pixel == p_Color; });
+  }
+};
+//---------------------------------------------------------------------------//
+// Every instruction set this cpu runs, Scalar first
+static std::vector<RasterIsa>
+supportedIsas()
+{
+  std::vector<RasterIsa> isas;
+  const RasterIsa previous = getRasterIsa();
+  for (RasterIsa isa : { RasterIsa::Scalar, RasterIsa::Sse41, RasterIsa::Avx2, RasterIsa::Avx512 })
+  {
+    if (setRasterIsa(isa))
+      isas.push_back(isa);
+  }
+  setRasterIsa(previous);
+  return isas;
+}
+//---------------------------------------------------------------------------//
+static bool
+sameStats(const RasterStats& p_A, const RasterStats& p_B)
+{
+  return 0 == memcmp(&p_A, &p_B, sizeof(RasterStats));
+}
+//---------------------------------------------------------------------------//
+// Random triangles around and across a p_Width x p_Height framebuffer: small
+// and large ones, slivers and a few degenerate after snapping
+static std::vector<ScreenTriangle>
+randomTriangles(uint32_t p_Seed, size_t p_Count, int p_Width, int p_Height)
+{
+  std::mt19937 random(p_Seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<ScreenTriangle> triangles(p_Count);
+  for (ScreenTriangle& triangle : triangles)
+  {
+    const float size = unit(random) < 0.1f ? 400.0f : unit(random) < 0.5f ? 40.0f : 4.0f;
+    const float cx = unit(random) * (p_Width + 40) - 20;
+    const float cy = unit(random) * (p_Height + 40) - 20;
+    for (Vec3F& corner : triangle.pos)
+      corner = Vec3F(cx + (unit(random) - 0.5f) * size, cy + (unit(random) - 0.5f) * size, unit(random) * 2.0f - 1.0f);
+    if (unit(random) < 0.02f)
+      triangle.pos[2] = triangle.pos[1];
+    triangle.color = (uint32_t)random() | 0xFF000000;
+  }
+  return triangles;
+}
+//---------------------------------------------------------------------------//
+// p_Width x p_Height RGBA texture of random texels
+static Texture
+randomTexture(uint32_t p_Seed, int p_Width, int p_Height)
+{
+  std::mt19937 random(p_Seed);
+  TGAImage image(p_Width, p_Height, TGAImage::RGBA);
+  std::vector<BGRA8> pixels((size_t)p_Width * p_Height);
+  for (BGRA8& p : pixels)
+  {
+    const uint32_t bits = (uint32_t)random();
+    p = { (uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24) };
+  }
+  image.write_pixels(pixels.data());
+  return Texture(image);
+}
+//---------------------------------------------------------------------------//
+static std::filesystem::path
+tempDirectory()
+{
+  const std::filesystem::path directory = std::filesystem::temp_directory_path() / "raster_tests";
+  std::filesystem::create_directories(directory);
+  return directory;
+}
+//---------------------------------------------------------------------------//
+static bool
+writeTextFile(const std::filesystem::path& p_Path, const std::string& p_Text)
+{
+  std::ofstream out(p_Path, std::ios::binary | std::ios::trunc);
+  return (bool)out.write(p_Text.data(), (std::streamsize)p_Text.size());
+}
+//---------------------------------------------------------------------------//
+static void
+flipByte(const std::filesystem::path& p_Path, std::streamoff p_Offset)
+{
+  std::fstream file(p_Path, std::ios::binary | std::ios::in | std::ios::out);
+  char byte = 0;
+  file.seekg(p_Offset);
+  file.get(byte);
+  file.seekp(p_Offset);
+  file.put((char)(byte ^ 1));
+}
+
+//---------------------------------------------------------------------------//
+// Raster tests
+//---------------------------------------------------------------------------//
+// A triangle larger than the framebuffer covers every pixel, one outside of
+// it none, and depth tested triangles draw the same pixels in either order
+static void
+testDrawTriangle()
+{
+  const int width = 97; // odd sizes leave partial blocks and tiles
+  const int height = 61;
+  TestTarget target(width, height);
+
+  const Vec3F covering[3] = { Vec3F(-10.0f, -10.0f, 0.0f), Vec3F(3.0f * width, -10.0f, 0.0f), Vec3F(-10.0f, 3.0f * height, 0.0f) };
+  target.clear();
+  drawTriangle(target.fb, covering, WHITE, true);
+  TEST_CHECK(target.isFilledWith(WHITE));
+
+  const Vec3F left[3] = { Vec3F(-50.0f, 10.0f, 0.0f), Vec3F(-5.0f, 20.0f, 0.0f), Vec3F(-20.0f, 50.0f, 0.0f) };
+  const Vec3F right[3] = { Vec3F(width + 5.0f, -30.0f, 0.0f), Vec3F(width + 60.0f, 20.0f, 0.0f), Vec3F(width + 1.0f, 90.0f, 0.0f) };
+  target.clear();
+  drawTriangle(target.fb, left, WHITE, true);
+  drawTriangle(target.fb, right, WHITE, false);
+  TEST_CHECK(target.isFilledWith(BLACK));
+
+  // overlapping triangles at different depths, the front one drawn first
+  // or last:
+  const Vec3F front[3] = { Vec3F(5.0f, 5.0f, 0.5f), Vec3F(80.0f, 10.0f, 0.5f), Vec3F(30.0f, 55.0f, 0.5f) };
+  const Vec3F back[3] = { Vec3F(90.0f, 3.0f, -0.5f), Vec3F(10.0f, 20.0f, -0.5f), Vec3F(60.0f, 58.0f, -0.5f) };
+  TestTarget frontFirst(width, height);
+  TestTarget backFirst(width, height);
+  frontFirst.clear();
+  backFirst.clear();
+  drawTriangle(frontFirst.fb, front, RED, true);
+  drawTriangle(frontFirst.fb, back, BLUE, true);
+  drawTriangle(backFirst.fb, back, BLUE, true);
+  drawTriangle(backFirst.fb, front, RED, true);
+  TEST_CHECK(frontFirst == backFirst);
+}
+//---------------------------------------------------------------------------//
+// Triangles with corners past the 2^24 pixel guard band are clipped, not
+// dropped: they cover the pixels whose centers are inside them, the same
+// ones serial and binned, flat and textured
+static void
+testGuardBand()
+{
+  const int width = 203;
+  const int height = 157;
+  const float out = 3e9f;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const Vec3F corners[][3] = {
+    // every corner out, the triangle covers the framebuffer:
+    { Vec3F(-out, -out, 0.0f), Vec3F(out, -out / 3, 0.25f), Vec3F(-out / 3, out, 0.5f) },
+    // one corner out, two edges cross the framebuffer:
+    { Vec3F(20.3f, 30.1f, 0.2f), Vec3F(180.6f, 61.7f, 0.2f), Vec3F(-4e8f, 9e8f, 0.9f) },
+    // two corners out on either side, the edge between them crosses it:
+    { Vec3F(-5e7f, 2e7f, 0.5f), Vec3F(7e8f, -3e8f, -0.5f), Vec3F(95.5f, 150.25f, 0.0f) },
+    // not a number, nothing to draw:
+    { Vec3F(10.0f, 10.0f, 0.0f), Vec3F(nan, 5e9f, 0.0f), Vec3F(90.0f, 60.0f, 0.0f) },
+  };
+  const Texture texture = randomTexture(37, 16, 16);
+  const TriangleUvs uvs = { { Vec2F(0.0f, 0.0f), Vec2F(1.0f, 0.0f), Vec2F(0.0f, 1.0f) } };
+
+  for (const auto& triangle : corners)
+  {
+    ScreenTriangle screen;
+    std::copy(triangle, triangle + 3, screen.pos);
+    screen.color = WHITE;
+
+    for (int textured = 0; textured < 2; textured++)
+    {
+      TestTarget serial(width, height);
+      TestTarget binned(width, height);
+      StatsRecorder serialStats;
+      StatsRecorder binnedStats;
+      serial.fb.stats = &serialStats;
+      binned.fb.stats = &binnedStats;
+      for (TestTarget* target : { &serial, &binned })
+      {
+        target->clear();
+        target->fb.stats->beginFrame(width, height);
+        target->fb.stats->beginDraw();
+      }
+      if (textured)
+      {
+        drawTriangleTextured(serial.fb, screen.pos, uvs.uv, screen.color, texture, true);
+        drawTrianglesTextured(binned.fb, &screen, &uvs, 1, texture, true);
+      }
+      else
+      {
+        drawTriangle(serial.fb, screen.pos, screen.color, true);
+        drawTriangles(binned.fb, &screen, 1, true);
+      }
+      serialStats.endDraw();
+      binnedStats.endDraw();
+      TEST_CHECK(serial == binned);
+      TEST_CHECK(sameStats(serialStats.lastDraw, binnedStats.lastDraw));
+      TEST_CHECK(1 == serialStats.lastDraw.trianglesClipped);
+      if (textured)
+        continue;
+      if (std::isnan(triangle[1].x))
+      {
+        TEST_CHECK(serial.isFilledWith(BLACK));
+        continue;
+      }
+
+      // pixel centers more than 0.1 pixels inside every edge are covered,
+      // the ones more than 0.1 pixels outside one are not:
+      int wrong = 0;
+      for (int y = 0; y < height; y++)
+      {
+        for (int x = 0; x < width; x++)
+        {
+          double inside = std::numeric_limits<double>::max();
+          for (int i = 0; i < 3; i++)
+          {
+            const Vec3F& a = triangle[i];
+            const Vec3F& b = triangle[(i + 1) % 3];
+            const Vec3F& c = triangle[(i + 2) % 3];
+            const double dx = (double)b.x - a.x, dy = (double)b.y - a.y;
+            const double side = dx * ((double)c.y - a.y) - dy * ((double)c.x - a.x);
+            const double distance = (dx * (y + 0.5 - a.y) - dy * (x + 0.5 - a.x)) / std::hypot(dx, dy);
+            inside = std::min(inside, side < 0.0 ? -distance : distance);
+          }
+          const uint32_t pixel = serial.color[(size_t)y * width + x];
+          wrong += (inside > 0.1 && WHITE != pixel) || (!(inside > -0.1) && BLACK != pixel);
+        }
+      }
+      if (wrong)
+        fprintf(stderr, "%d pixels wrong for a triangle with a corner at %g, %g\n", wrong, triangle[1].x, triangle[1].y);
+      TEST_CHECK(0 == wrong);
+    }
+  }
+}
+//---------------------------------------------------------------------------//
+// The model passes under every instruction set and block traversal draw the
+// pixels of the scalar row walk
+static void
+testIsaPixels()
+{
+  Model model(HEAD_OBJ, false);
+  TEST_CHECK(model.initialized);
+  if (!model.initialized)
+    return;
+  const Texture texture = randomTexture(7, 61, 43);
+  const RasterIsa previousIsa = getRasterIsa();
+  const RasterTraversal previousTraversal = getRasterTraversal();
+
+  auto render = [&](TestTarget& p_Target, int p_Pass) {
+    p_Target.clear();
+    p_Target.fb.flipVertically = true;
+    switch (p_Pass)
+    {
+    case 0: drawModelFlat(p_Target.fb, model, Camera()); break;
+    case 1: drawModelDepth(p_Target.fb, model, Camera()); break;
+    default: drawModelTextured(p_Target.fb, model, texture, Camera()); break;
+    }
+  };
+
+  for (int pass = 0; pass < 3; pass++)
+  {
+    setRasterIsa(RasterIsa::Scalar);
+    setRasterTraversal(RasterTraversal::Rows);
+    TestTarget reference(512, 512);
+    render(reference, pass);
+
+    for (RasterIsa isa : supportedIsas())
+    {
+      setRasterIsa(isa);
+      for (RasterTraversal traversal : { RasterTraversal::Rows, RasterTraversal::Tiles, RasterTraversal::Columns })
+      {
+        setRasterTraversal(traversal);
+        TestTarget target(512, 512);
+        render(target, pass);
+        if (!(target == reference))
+          fprintf(stderr, "pass %d differs with %s, %s\n", pass, getRasterIsaName(isa), getRasterTraversalName(traversal));
+        TEST_CHECK(target == reference);
+      }
+    }
+  }
+  setRasterIsa(previousIsa);
+  setRasterTraversal(previousTraversal);
+}
+//---------------------------------------------------------------------------//
+// drawTriangles (tile binned on the job system) against drawTriangle one
+// triangle at a time: same pixels and same stats, textured or not. Textured
+// triangles walk the same blocks as flat ones and count the same stats.
+static void
+testDrawTriangles()
+{
+  const int width = 640;
+  const int height = 480;
+  const std::vector<ScreenTriangle> triangles = randomTriangles(11, 3000, width, height);
+  std::vector<TriangleUvs> uvs(triangles.size());
+  std::mt19937 random(12);
+  std::uniform_real_distribution<float> uv(-2.0f, 2.0f);
+  for (TriangleUvs& corners : uvs)
+    for (Vec2F& corner : corners.uv)
+      corner = Vec2F(uv(random), uv(random));
+  const Texture texture = randomTexture(13, 32, 17);
+
+  RasterStats flatStats[2];
+  for (int textured = 0; textured < 2; textured++)
+  {
+    for (int depthTest = 0; depthTest < 2; depthTest++)
+    {
+      TestTarget serial(width, height);
+      TestTarget binned(width, height);
+      StatsRecorder serialStats;
+      StatsRecorder binnedStats;
+      serial.fb.stats = &serialStats;
+      binned.fb.stats = &binnedStats;
+
+      for (TestTarget* target : { &serial, &binned })
+      {
+        target->clear();
+        target->fb.stats->beginFrame(width, height);
+        target->fb.stats->beginDraw();
+      }
+      for (size_t i = 0; i < triangles.size(); i++)
+      {
+        if (textured)
+          drawTriangleTextured(serial.fb, triangles[i].pos, uvs[i].uv, triangles[i].color, texture, 0 != depthTest);
+        else
+          drawTriangle(serial.fb, triangles[i].pos, triangles[i].color, 0 != depthTest);
+      }
+      if (textured)
+        drawTrianglesTextured(binned.fb, triangles.data(), uvs.data(), triangles.size(), texture, 0 != depthTest);
+      else
+        drawTriangles(binned.fb, triangles.data(), triangles.size(), 0 != depthTest);
+      serialStats.endDraw();
+      binnedStats.endDraw();
+
+      if (!(serial == binned) || !sameStats(serialStats.lastDraw, binnedStats.lastDraw))
+        fprintf(stderr, "textured %d depth %d differs\n", textured, depthTest);
+      TEST_CHECK(serial == binned);
+      TEST_CHECK(sameStats(serialStats.lastDraw, binnedStats.lastDraw));
+      if (textured)
+        TEST_CHECK(sameStats(serialStats.lastDraw, flatStats[depthTest]));
+      else
+        flatStats[depthTest] = serialStats.lastDraw;
+    }
+  }
+}
+//---------------------------------------------------------------------------//
+// The batched samplers of every instruction set against the scalar ones,
+// with coordinates that wrap, land on texel edges or are not numbers
+static void
+testTextureSamplers()
+{
+  const Texture texture = randomTexture(17, 37, 23);
+  TEST_CHECK(texture.isValid());
+
+  std::mt19937 random(19);
+  std::uniform_real_distribution<float> wide(-4.0f, 4.0f);
+  std::vector<float> u, v;
+  for (int i = 0; i < 2000; i++)
+  {
+    u.push_back(wide(random));
+    v.push_back(wide(random));
+  }
+  const float specials[] = {
+    0.0f, -0.0f, 1.0f, -1.0f, 0.5f / 37, 1.0f - 1e-7f, 1e9f, -1e9f,
+    std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+    std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::denorm_min() };
+  for (float a : specials)
+  {
+    for (float b : specials)
+    {
+      u.push_back(a);
+      v.push_back(b);
+    }
+  }
+  u.push_back(0.25f); // an odd count leaves a scalar tail
+  v.push_back(0.75f);
+  const uint32_t count = (uint32_t)u.size();
+
+  std::vector<uint32_t> point(count), bilinear(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    point[i] = texture.samplePoint(u[i], v[i]);
+    bilinear[i] = texture.sampleBilinear(u[i], v[i]);
+  }
+
+  const RasterIsa previous = getRasterIsa();
+  for (RasterIsa isa : supportedIsas())
+  {
+    setRasterIsa(isa);
+    std::vector<uint32_t> batched(count);
+    texture.samplePoint(u.data(), v.data(), count, batched.data());
+    TEST_CHECK(batched == point);
+    texture.sampleBilinear(u.data(), v.data(), count, batched.data());
+    TEST_CHECK(batched == bilinear);
+  }
+  setRasterIsa(previous);
+
+  // texel centers sample exactly, v = 0 is the bottom row:
+  TEST_CHECK(texture.sampleBilinear(0.5f / 37, 0.5f / 23) == texture.fetch(0, 0));
+  TEST_CHECK(texture.samplePoint(36.5f / 37, 22.5f / 23) == texture.fetch(36, 22));
+}
+//---------------------------------------------------------------------------//
+// A model drawn through ModelStream draws the pixels of the loaded model,
+// with a budget small enough to spill the obj positions to a temporary file
+static void
+testStreamedModel()
+{
+  Model model(HEAD_OBJ, false);
+  TEST_CHECK(model.initialized);
+  if (!model.initialized)
+    return;
+
+  for (int depthTest = 0; depthTest < 2; depthTest++)
+  {
+    TestTarget loaded(512, 512);
+    TestTarget streamed(512, 512);
+    loaded.clear();
+    streamed.clear();
+    loaded.fb.flipVertically = streamed.fb.flipVertically = true;
+    if (depthTest)
+      drawModelDepth(loaded.fb, model, Camera());
+    else
+      drawModelFlat(loaded.fb, model, Camera());
+    TEST_CHECK(drawModelStreamed(streamed.fb, HEAD_OBJ, Camera(), 0 != depthTest, 64 << 10, false));
+    TEST_CHECK(loaded.color == streamed.color);
+  }
+}
+//---------------------------------------------------------------------------//
+// A frame renders on the calling thread's own job slot while a loader thread
+// parses a large obj with jobs of its own
+static void
+testRenderDuringLoad()
+{
+  // a few MB of positions, more than the two chunks the parser splits into
+  // jobs:
+  const std::filesystem::path path = tempDirectory() / "load_during_frame.obj";
+  {
+    std::string text;
+    std::mt19937 random(23);
+    std::uniform_int_distribution<int> coordinate(-99999, 99999);
+    const int vertices = 600000;
+    for (int i = 0; i < vertices; i++)
+      text += "v 0." + std::to_string(coordinate(random)) + " 0." + std::to_string(coordinate(random)) + " 0.5\n";
+    for (int i = 0; i + 3 <= vertices; i += 3)
+      text += "f " + std::to_string(i + 1) + " " + std::to_string(i + 2) + " " + std::to_string(i + 3) + "\n";
+    TEST_CHECK(writeTextFile(path, text));
+  }
+
+  Model model(HEAD_OBJ, false);
+  TestTarget target(256, 256);
+  AssetHandle<Model> loading = AssetLoader::loadModel(path.string(), false);
+  int framesDuringLoad = 0;
+  while (AssetState::Loading == loading.getState())
+  {
+    target.clear();
+    drawModelDepth(target.fb, model, Camera());
+    framesDuringLoad += AssetState::Loading == loading.getState();
+  }
+  const Model* loaded = loading.wait();
+  fprintf(stderr, "%d frames rendered during the load\n", framesDuringLoad);
+  TEST_CHECK(framesDuringLoad > 0);
+  TEST_CHECK(nullptr != loaded && 200000 == loaded->nfaces());
+
+  loading = {};
+  std::filesystem::remove(path);
+}
+
+//---------------------------------------------------------------------------//
+// File format tests
+//---------------------------------------------------------------------------//
+// Every attribute of a model comes back from its mesh cache bit for bit. Only
+// the header and the index range are checked by default, verify_cache also
+// catches a bad stream.
+static void
+testMeshCache()
+{
+  const std::filesystem::path obj = tempDirectory() / "mesh_cache.obj";
+  const std::filesystem::path cache = obj.string() + ".mesh";
+  std::filesystem::copy_file(HEAD_OBJ, obj, std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::remove(cache);
+
+  Model parsed(obj.string().c_str(), false);
+  TEST_CHECK(parsed.initialized);
+  auto same = [&](const Model& p_Model) {
+    auto bytes = [](auto p_Span) { return std::vector<uint8_t>((const uint8_t*)p_Span.data(), (const uint8_t*)(p_Span.data() + p_Span.size())); };
+    return p_Model.initialized &&
+      bytes(p_Model.verts()) == bytes(parsed.verts()) &&
+      bytes(p_Model.uvs()) == bytes(parsed.uvs()) &&
+      bytes(p_Model.normals()) == bytes(parsed.normals()) &&
+      bytes(p_Model.indices16()) == bytes(parsed.indices16()) &&
+      bytes(p_Model.indices32()) == bytes(parsed.indices32()) &&
+      0 == memcmp(p_Model.bounds_min().raw, parsed.bounds_min().raw, sizeof(Vec3f)) &&
+      0 == memcmp(p_Model.bounds_max().raw, parsed.bounds_max().raw, sizeof(Vec3f));
+  };
+
+  {
+    Model written(obj.string().c_str(), true);
+    TEST_CHECK(!written.from_cache && same(written));
+  }
+  TEST_CHECK(std::filesystem::exists(cache));
+  {
+    Model cached(obj.string().c_str(), true, true);
+    TEST_CHECK(cached.from_cache && same(cached));
+  }
+
+  // a flipped bit in the last stream (the indices) that leaves the index in
+  // range:
+  flipByte(cache, (std::streamoff)std::filesystem::file_size(cache) - 16);
+  {
+    Model unverified(obj.string().c_str(), true);
+    TEST_CHECK(unverified.from_cache);
+  }
+  {
+    Model verified(obj.string().c_str(), true, true);
+    TEST_CHECK(!verified.from_cache && same(verified));
+  }
+
+  // the cache was written again, a flipped bit in the header (its reserved
+  // word) is always seen:
+  flipByte(cache, 36);
+  {
+    Model reparsed(obj.string().c_str(), true);
+    TEST_CHECK(!reparsed.from_cache && same(reparsed));
+  }
+
+  std::filesystem::remove(obj);
+  std::filesystem::remove(cache);
+}
+//---------------------------------------------------------------------------//
+// An index past the vertices is seen on a load without verify_cache, the obj
+// is parsed again instead of handing the pipeline an out of range index
+static void
+testMeshCacheIndexRange()
+{
+  const std::filesystem::path obj = tempDirectory() / "mesh_cache_index.obj";
+  const std::filesystem::path cache = obj.string() + ".mesh";
+  std::filesystem::copy_file(HEAD_OBJ, obj, std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::remove(cache);
+  {
+    Model written(obj.string().c_str(), true);
+    TEST_CHECK(written.initialized && written.has_indices16() && written.nverts() < 0xFFFF);
+  }
+
+  // the index buffer is the last stream, padded to 8 bytes:
+  Model parsed(obj.string().c_str(), false);
+  const std::uintmax_t indexBytes = (parsed.indices16().size_bytes() + 7) / 8 * 8;
+  {
+    std::fstream file(cache, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp((std::streamoff)(std::filesystem::file_size(cache) - indexBytes));
+    const uint16_t outOfRange = 0xFFFF;
+    file.write((const char*)&outOfRange, sizeof(outOfRange));
+  }
+  {
+    Model reparsed(obj.string().c_str(), true);
+    TEST_CHECK(reparsed.initialized && !reparsed.from_cache);
+    TEST_CHECK(std::equal(reparsed.indices16().begin(), reparsed.indices16().end(), parsed.indices16().begin(), parsed.indices16().end()));
+  }
+  {
+    Model cached(obj.string().c_str(), true);
+    TEST_CHECK(cached.from_cache);
+  }
+
+  std::filesystem::remove(obj);
+  std::filesystem::remove(cache);
+}
+//---------------------------------------------------------------------------//
+// Decimal strings parse to what std::from_chars gives, the fast path
+// included. Positions are compared through the index buffer, the model
+// orders its vertices by first use.
+static void
+testObjFloats()
+{
+  std::vector<std::string> numbers = {
+    "0", "-0", "+1.5", "0.1", "1e-7", "3.4028235e38", "1.17549435e-38", "1e-45", "7e22", "1e23",
+    "0.30000001192092896", "1.00000005960464477539", "1.000000059604644775390625", "16777217",
+    "123456789012345678901", "0.000000000000000000000000000000000000000001", "9007199254740993",
+    "4.7019774032891500318986215e-38", "2.5e-8", "1.", ".5", "1E3", "-1.17549421e-38",
+    // next to a float halfway point, their nearest double is exactly on it:
+    "9.000000476837159", "-9.000000476837159", "9.000001430511474", "9.000000476837158" };
+  std::mt19937 random(29);
+  for (int i = 0; i < 3000; i++)
+  {
+    // random floats printed short and in full, random digit strings:
+    const uint32_t bits = (uint32_t)random() & 0xBFFFFFFF; // exponents well inside the float range
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    char text[64];
+    snprintf(text, sizeof(text), i % 3 ? "%.9g" : "%.17g", value);
+    numbers.push_back(text);
+    snprintf(text, sizeof(text), "%u.%ue%d", (uint32_t)random() % 100000, (uint32_t)random(), (int)(random() % 60) - 30);
+    numbers.push_back(text);
+  }
+  while (numbers.size() % 3)
+    numbers.push_back("1");
+
+  std::string text;
+  for (size_t i = 0; i < numbers.size(); i += 3)
+    text += "v " + numbers[i] + " " + numbers[i + 1] + " " + numbers[i + 2] + "\n";
+  for (size_t i = 0; i + 3 <= numbers.size() / 3; i += 3)
+    text += "f " + std::to_string(i + 1) + " " + std::to_string(i + 2) + " " + std::to_string(i + 3) + "\n";
+  const std::filesystem::path path = tempDirectory() / "floats.obj";
+  TEST_CHECK(writeTextFile(path, text));
+
+  Model model(path.string().c_str(), false);
+  TEST_CHECK(model.initialized);
+  if (model.initialized)
+  {
+    int mismatches = 0;
+    for (int face = 0; face < model.nfaces(); face++)
+    {
+      const std::array<uint32_t, 3> corners = model.triangle(face);
+      for (int corner = 0; corner < 3; corner++)
+      {
+        const Vec3f position = model.vert((int)corners[corner]);
+        for (int axis = 0; axis < 3; axis++)
+        {
+          const std::string& number = numbers[(size_t)(face * 3 + corner) * 3 + axis];
+          const char* begin = number.data() + ('+' == number[0]);
+          float expected = 0.0f;
+          std::from_chars(begin, number.data() + number.size(), expected);
+          if (0 != memcmp(&expected, &position.raw[axis], sizeof(float)) && mismatches++ < 10)
+            fprintf(stderr, "%s parsed as %.9g, from_chars gives %.9g\n", number.c_str(), position.raw[axis], expected);
+        }
+      }
+    }
+    TEST_CHECK(0 == mismatches);
+  }
+  std::filesystem::remove(path);
+}
+//---------------------------------------------------------------------------//
+// Face indices that don't fit in 32 bits fail the load instead of wrapping
+// around to a valid vertex
+static void
+testObjIndexOverflow()
+{
+  const std::filesystem::path path = tempDirectory() / "overflow.obj";
+  for (const char* face : { "f 1 2 4294967297", "f 1 2 99999999999999999999999", "f 1 2 -18446744073709551617" })
+  {
+    TEST_CHECK(writeTextFile(path, std::string("v 0 0 0\nv 1 0 0\nv 0 1 0\n") + face + "\n"));
+    Model model(path.string().c_str(), false);
+    TEST_CHECK(!model.initialized);
+  }
+  TEST_CHECK(writeTextFile(path, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 -1\n"));
+  Model model(path.string().c_str(), false);
+  TEST_CHECK(model.initialized && 1 == model.nfaces());
+  std::filesystem::remove(path);
+}
+//---------------------------------------------------------------------------//
+// Every format and compression reads back the pixels it was written with
+static void
+testTgaRoundTrip()
+{
+  const std::filesystem::path path = tempDirectory() / "round_trip.tga";
+  std::mt19937 random(31);
+  const int width = 300; // runs longer than the 128 pixels of an rle packet
+  const int height = 37;
+
+  // noise rows, runs and rows that alternate between the two:
+  std::vector<BGRA8> pixels((size_t)width * height);
+  for (int y = 0; y < height; y++)
+  {
+    const uint32_t run = (uint32_t)random();
+    for (int x = 0; x < width; x++)
+    {
+      const uint32_t bits = (y % 3 == 0 || (y % 3 == 2 && x % 50 < 25)) ? run : (uint32_t)random();
+      pixels[(size_t)y * width + x] = { (uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24) };
+    }
+  }
+
+  for (int bpp : { TGAImage::GRAYSCALE, TGAImage::RGB, TGAImage::RGBA })
+  {
+    TGAImage image(width, height, bpp);
+    image.write_pixels(pixels.data());
+    std::vector<BGRA8> expected((size_t)width * height);
+    image.read_pixels(expected.data());
+
+    for (int rle = 0; rle < 2; rle++)
+    {
+      for (int vflip = 0; vflip < 2; vflip++)
+      {
+        TEST_CHECK(image.write_tga_file(path.string(), 0 != vflip, 0 != rle, JobSystem::parallelRanges));
+        TGAImage read;
+        TEST_CHECK(read.read_tga_file(path.string()));
+        TEST_CHECK(width == read.width() && height == read.height());
+        std::vector<BGRA8> actual((size_t)width * height);
+        read.read_pixels(actual.data());
+
+        // vflip marks the rows as bottom-up, they read back upside down:
+        bool same = true;
+        for (int y = 0; y < height; y++)
+        {
+          const int expectedY = vflip ? height - 1 - y : y;
+          same &= 0 == memcmp(&actual[(size_t)y * width], &expected[(size_t)expectedY * width], width * sizeof(BGRA8));
+        }
+        TEST_CHECK(same);
+      }
+    }
+  }
+
+  // the framebuffer writer, RGBA8 with red in the low byte:
+  std::vector<uint32_t> rgba((size_t)width * height);
+  for (size_t i = 0; i < rgba.size(); i++)
+    rgba[i] = pixels[i].b | (uint32_t)pixels[i].g << 8 | (uint32_t)pixels[i].r << 16 | (uint32_t)pixels[i].a << 24;
+  for (int rle = 0; rle < 2; rle++)
+  {
+    TEST_CHECK(TGAImage::write_tga_file(path.string(), rgba.data(), width, height, false, 0 != rle, JobSystem::parallelRanges));
+    TGAImage read;
+    TEST_CHECK(read.read_tga_file(path.string()));
+    std::vector<BGRA8> actual((size_t)width * height);
+    read.read_pixels(actual.data());
+    bool same = true;
+    for (size_t i = 0; i < rgba.size(); i++)
+      same &= actual[i].r == (uint8_t)rgba[i] && actual[i].g == (uint8_t)(rgba[i] >> 8) &&
+        actual[i].b == (uint8_t)(rgba[i] >> 16) && actual[i].a == (uint8_t)(rgba[i] >> 24);
+    TEST_CHECK(same);
+  }
+  std::filesystem::remove(path);
+
+#ifndef _WIN32
+  // a small file stays in the stream buffer until close, which is where a
+  // full disk shows up:
+  TEST_CHECK(!TGAImage::write_tga_file("/dev/full", rgba.data(), 4, 4, false, false));
+#endif
+}
+
+//---------------------------------------------------------------------------//
+// Main function
+//---------------------------------------------------------------------------//
+struct TestCase
+{
+  const char* name;
+  void (*run)();
+};
+//---------------------------------------------------------------------------//
+static const TestCase ms_Tests[] = {
+  { "draw_triangle", testDrawTriangle },
+  { "guard_band", testGuardBand },
+  { "isa_pixels", testIsaPixels },
+  { "draw_triangles", testDrawTriangles },
+  { "texture_samplers", testTextureSamplers },
+  { "streamed_model", testStreamedModel },
+  { "render_during_load", testRenderDuringLoad },
+  { "mesh_cache", testMeshCache },
+  { "mesh_cache_index_range", testMeshCacheIndexRange },
+  { "obj_floats", testObjFloats },
+  { "obj_index_overflow", testObjIndexOverflow },
+  { "tga_round_trip", testTgaRoundTrip },
+};
+//---------------------------------------------------------------------------//
+static bool
+runTest(const TestCase& p_Test)
+{
+  const int failures = g_Failures;
+  p_Test.run();
+  const bool passed = failures == g_Failures;
+  fprintf(stderr, "%-24s %s\n", p_Test.name, passed ? "passed" : "FAILED");
+  return passed;
+}
+//---------------------------------------------------------------------------//
+int
+main(int p_Argc, char** p_Argv)
+{
+  // more threads than this cpu may have, so the binned and job paths run:
+  JobSystem::setThreadCount(4);
+
+  if (p_Argc < 2)
+  {
+    for (const TestCase& test : ms_Tests)
+      runTest(test);
+    return g_Failures ? 1 : 0;
+  }
+
+  for (int i = 1; i < p_Argc; i++)
+  {
+    const TestCase* found = nullptr;
+    for (const TestCase& test : ms_Tests)
+      found = 0 == strcmp(test.name, p_Argv[i]) ? &test : found;
+    if (nullptr == found)
+    {
+      fprintf(stderr, "usage: %s [test ...]\ntests:", p_Argv[0]);
+      for (const TestCase& test : ms_Tests)
+        fprintf(stderr, " %s", test.name);
+      fprintf(stderr, "\n");
+      return 1;
+    }
+    runTest(*found);
+  }
+  return g_Failures ? 1 : 0;
+}
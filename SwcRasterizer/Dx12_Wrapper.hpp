@@ -7,6 +7,8 @@
 
 #include "d3dx12.h"
 
+#include <RasterCore/Profiler.hpp>
+
 #include <wrl.h>
 using Microsoft::WRL::ComPtr;
 
@@ -197,6 +199,8 @@ struct Dx12Wrapper{
   static void
   onRender()
   {
+    RASTER_PROFILE_ZONE("present");
+
     // Command list allocators can only be reset when the associated 
     // command lists have finished execution on the GPU; apps should use 
     // fences to determine GPU execution progress.
@@ -10,28 +10,19 @@
 #include <algorithm>
 
 #include <tinyrenderer/model.h>
+#include <RasterCore/Raster.hpp>
+#include <RasterCore/Asset_Loader.hpp>
 
 //---------------------------------------------------------------------------//
 // Global variables:
 //---------------------------------------------------------------------------//
 HWND g_Window;
-Model* g_Model;
-float* g_DepthBuffer;
-
-bool g_FlipVertically;
+AssetHandle<Model> g_Model; // drawn once the loader finished it
+Framebuffer g_Framebuffer;
 
 //---------------------------------------------------------------------------//
 // Helper functions:
 //---------------------------------------------------------------------------//
-template <typename T> inline T alignUp(T p_Val, T p_Alignment)
-{
-  return (p_Val + p_Alignment - (T)1) & ~(p_Alignment - (T)1);
-}
-//---------------------------------------------------------------------------//
-template <typename T, size_t N> constexpr size_t arrayCount(T(&)[N]) { return N; }
-//---------------------------------------------------------------------------//
-template <typename T, uint32_t N> constexpr uint32_t arrayCount32(T(&)[N]) { return N; }
-//---------------------------------------------------------------------------//
 inline void traceHr(const std::string& p_Msg, HRESULT p_Hr)
 {
   char hrMsg[512];
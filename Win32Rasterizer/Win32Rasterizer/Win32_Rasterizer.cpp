@@ -12,6 +12,7 @@
 // <ccomplex>, <cstdalign>, <cstdbool>, and <ctgmath> are deprecated.
 #include <tinyrenderer/tgaimage.h>
 #include <tinyrenderer/model.h>
+#include <RasterCore/Asset_Loader.hpp>
 
 // Enable to flip y for wireframe model:
 // https://github.com/ssloy/tinyrenderer/wiki/Lesson-1:-Bresenham%E2%80%99s-Line-Drawing-Algorithm
@@ -56,7 +57,7 @@ static constexpr ColorRGBA BLUE = { 0.0f, 0.0f, 1.0f, 1.0f };
 static bool g_Running;
 static BackBuffer g_BackBuffer;
 static HDC g_DeviceContext;
-static Model* g_Model = nullptr;
+static AssetHandle<Model> g_Model;
 
 
 //---------------------------------------------------------------------------//
@@ -359,12 +360,13 @@ LRESULT CALLBACK WindowProc(
 
         // Draw the loaded Model
         // NOTE(OM): The y-coordinate is upside down ^^
-        assert(g_Model->initialized);
-        for (int i = 0; i < g_Model->nfaces(); i++) {
-          std::vector<int> face = g_Model->face(i);
+        // Nothing to draw while the loader is still busy with it:
+        const Model* model = g_Model.get();
+        for (int i = 0; model && i < model->nfaces(); i++) {
+          std::array<uint32_t, 3> face = model->triangle(i);
           for (int j = 0; j < 3; j++) {
-            Vec3f v0 = g_Model->vert(face[j]);
-            Vec3f v1 = g_Model->vert(face[(j + 1) % 3]);
+            Vec3f v0 = model->vert(face[j]);
+            Vec3f v1 = model->vert(face[(j + 1) % 3]);
             int x0 = (v0.x + 1.) * g_BackBuffer.width / 2.;
             int y0 = (v0.y + 1.) * g_BackBuffer.height / 2.;
             int x1 = (v1.x + 1.) * g_BackBuffer.width / 2.;
@@ -426,9 +428,8 @@ WinMain (
   assert(windowHandle);
   g_DeviceContext = GetDC(windowHandle);
 
-  // Load model
-  g_Model = new Model("../../Assets/obj/african_head/african_head.obj");
-  assert(g_Model->initialized);
+  // Load model in the background
+  g_Model = AssetLoader::loadModel("../../Assets/obj/african_head/african_head.obj");
 
   // Initialize and clear global buffer:
   WindowDimension dimension = getWindowDimension(windowHandle);